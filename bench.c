@@ -0,0 +1,190 @@
+
+#include <stdio.h>
+#include <time.h>
+
+#define FIREF_IMPL
+#include "firef.h"
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static char *read_all(const char *path, size_t *size) {
+    FILE *file = fopen(path, "rb");
+    if (!file) {
+        fprintf(stderr, "Failed to open %s\n", path);
+        exit(1);
+    }
+    fseek(file, 0, SEEK_END);
+    *size = (size_t)ftell(file);
+    fseek(file, 0, SEEK_SET);
+    char *data = (char*)malloc(*size + 1);
+    if (!data || fread(data, 1, *size, file) != *size) exit(1);
+    data[*size] = '\0';
+    fclose(file);
+    return data;
+}
+
+// Collects every number on the v/vt/vn lines of an OBJ as its own
+// NUL-terminated string, so both parsers see exactly the same input.
+static char **collect_numbers(char *data, size_t *count) {
+    size_t cap = 1024;
+    char **numbers = (char**)malloc(cap * sizeof(char*));
+    *count = 0;
+    for (char *line = strtok(data, "\n"); line; line = strtok(NULL, "\n")) {
+        if (line[0] != 'v') continue;
+        char *p = line + 1;
+        if (*p == 't' || *p == 'n') p++;
+        for (;;) {
+            while (isspace((unsigned char)*p)) p++;
+            if (*p == '\0') break;
+            char *start = p;
+            while (*p && !isspace((unsigned char)*p)) p++;
+            if (*p) *p++ = '\0';
+            if (*count == cap) {
+                cap *= 2;
+                numbers = (char**)realloc(numbers, cap * sizeof(char*));
+            }
+            numbers[(*count)++] = start;
+        }
+    }
+    return numbers;
+}
+
+int main(int argc, char **argv) {
+    const char *path = argc > 1 ? argv[1] : "Skull.obj";
+    const int rounds = 50;
+
+    size_t size;
+    char *data = read_all(path, &size);
+    size_t count;
+    char **numbers = collect_numbers(data, &count);
+
+    size_t mismatches = 0;
+    for (size_t i = 0; i < count; i++) {
+        float a = strtof(numbers[i], NULL);
+        float b = parse_float(numbers[i]);
+        if (memcmp(&a, &b, sizeof(float)) != 0) mismatches++;
+    }
+
+    volatile float sink = 0.0f;
+    double start = now_seconds();
+    for (int r = 0; r < rounds; r++)
+        for (size_t i = 0; i < count; i++) sink += strtof(numbers[i], NULL);
+    double strtof_time = now_seconds() - start;
+
+    start = now_seconds();
+    for (int r = 0; r < rounds; r++)
+        for (size_t i = 0; i < count; i++) sink += parse_float(numbers[i]);
+    double firef_time = now_seconds() - start;
+    (void)sink;
+
+    printf("==== Float parsing (%zu numbers from %s, %d rounds) ====\n", count, path, rounds);
+    printf("  strtof:       %7.2f ns/number\n", strtof_time * 1e9 / (count * (double)rounds));
+    printf("  parse_float:  %7.2f ns/number (%.2fx)\n", firef_time * 1e9 / (count * (double)rounds), strtof_time / firef_time);
+    printf("  mismatches:   %zu\n", mismatches);
+
+    start = now_seconds();
+    size_t index_count = 0;
+    for (int r = 0; r < rounds; r++) {
+        Obj mesh = load_obj(path);
+        index_count += mesh.index_count;
+        free_obj(&mesh);
+    }
+    double load_time = (now_seconds() - start) / rounds;
+    printf("\n==== load_obj (%s, %zu bytes) ====\n", path, size);
+    printf("  %.3f ms/load, %.1f MB/s\n", load_time * 1e3, size / load_time / 1e6);
+
+    // The scratch peak shows what FIREF_LOAD_EXACT_SIZE saves on regrowing.
+    for (int exact = 0; exact < 2; exact++) {
+        ObjArena scratch;
+        obj_arena_init(&scratch, NULL, 0);
+        ObjLoadOptions arena_options = {0};
+        arena_options.flags = exact ? FIREF_LOAD_EXACT_SIZE : 0;
+        arena_options.scratch_arena = &scratch;
+        start = now_seconds();
+        for (int r = 0; r < rounds; r++) {
+            Obj mesh = load_obj_ex(path, &arena_options);
+            free_obj(&mesh);
+        }
+        load_time = (now_seconds() - start) / rounds;
+        printf("  %.3f ms/load with a scratch arena%s (peak %zu bytes)\n", load_time * 1e3, exact ? ", exact size" : "", scratch.peak);
+        obj_arena_free(&scratch);
+    }
+
+    // The same file over and over stands in for a level's worth of props.
+    enum { batch_count = 16 };
+    const char *batch_paths[batch_count];
+    Obj batch[batch_count];
+    for (int i = 0; i < batch_count; i++) batch_paths[i] = path;
+    printf("\n==== load_obj_batch (%d files) ====\n", batch_count);
+    for (int threads = 1; threads <= 8; threads *= 8) {
+        start = now_seconds();
+        size_t failed = load_obj_batch(batch_paths, batch_count, batch, threads);
+        printf("  %d thread%s:    %7.3f ms (%zu failed)\n", threads, threads > 1 ? "s" : " ", (now_seconds() - start) * 1e3, failed);
+        for (int i = 0; i < batch_count; i++) free_obj(&batch[i]);
+    }
+
+    ObjLoadOptions options = {0};
+    options.flags = FIREF_LOAD_DEDUPLICATE | FIREF_LOAD_POSITIONS | FIREF_LOAD_NO_CACHE;
+    Obj mesh = load_obj_ex(path, &options);
+    const int bvh_threads[2] = { 1, 8 };
+    ObjBvh bvh;
+    printf("\n==== BVH (%zu triangles) ====\n", mesh.index_count / 3);
+    for (int i = 0; i < 2; i++) {
+        start = now_seconds();
+        for (int r = 0; r < rounds; r++) {
+            obj_build_bvh(&mesh, bvh_threads[i], &bvh);
+            if (r + 1 < rounds) free_bvh(&bvh);
+        }
+        printf("  build, %d thread%s: %7.3f ms (%zu nodes)\n", bvh_threads[i], bvh_threads[i] > 1 ? "s" : " ",
+               (now_seconds() - start) * 1e3 / rounds, bvh.node_count);
+        if (i == 0) free_bvh(&bvh);
+    }
+
+    // Rays from a shell around the mesh towards random points in its box.
+    const int ray_count = 1000000;
+    const ObjBounds *bounds = &mesh.bounds;
+    float (*rays)[6] = (float(*)[6])malloc(ray_count * sizeof(*rays));
+    srand(1);
+    for (int r = 0; r < ray_count; r++) {
+        for (int k = 0; k < 3; k++) {
+            float origin = bounds->center[k] + ((float)rand() / RAND_MAX * 2.0f - 1.0f) * bounds->radius * 1.5f;
+            float target = bounds->min[k] + (bounds->max[k] - bounds->min[k]) * ((float)rand() / RAND_MAX);
+            rays[r][k] = origin;
+            rays[r][k + 3] = target - origin;
+        }
+    }
+    size_t hits = 0;
+    start = now_seconds();
+    for (int r = 0; r < ray_count; r++) {
+        ObjRayHit hit;
+        hits += (size_t)obj_bvh_intersect(&bvh, rays[r], rays[r] + 3, FLT_MAX, &hit);
+    }
+    double closest_time = now_seconds() - start;
+    start = now_seconds();
+    for (int r = 0; r < ray_count; r++) hits += (size_t)obj_bvh_occluded(&bvh, rays[r], rays[r] + 3, FLT_MAX);
+    double any_time = now_seconds() - start;
+    printf("  closest hit:  %7.2f Mrays/s\n", ray_count / closest_time / 1e6);
+    printf("  any hit:      %7.2f Mrays/s (%zu hits)\n", ray_count / any_time / 1e6, hits);
+    free(rays);
+    free_bvh(&bvh);
+
+    const float lod_ratios[4] = { 0.5f, 0.25f, 0.1f, 0.01f };
+    ObjLodChain lods;
+    start = now_seconds();
+    obj_build_lods(&mesh, lod_ratios, 4, 1.0f, 0, &lods);
+    printf("\n==== LOD chain ====\n");
+    printf("  build:        %7.3f ms\n", (now_seconds() - start) * 1e3);
+    for (size_t l = 0; l < lods.level_count; l++) {
+        printf("  %5.2f:        %7zu triangles, error %g\n", lod_ratios[l], lods.levels[l].index_count / 3, lods.levels[l].error);
+    }
+    free_lod_chain(&lods);
+    free_obj(&mesh);
+
+    free(numbers);
+    free(data);
+    return 0;
+}
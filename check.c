@@ -0,0 +1,485 @@
+#include <stdio.h>
+#include <math.h>
+
+// Small chunks, so that multi-threaded loads of the generated files split
+// them in many places.
+#define FIREF_MIN_CHUNK_SIZE 256
+#define FIREF_IMPL
+#include "firef.h"
+
+static int failures = 0;
+
+#define CHECK(cond) do { \
+    if (!(cond)) { \
+        fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+        failures++; \
+    } \
+} while (0)
+
+static uint64_t random_state = 0x9E3779B97F4A7C15ULL;
+
+static uint32_t next_random(void) {
+    random_state = random_state * 6364136223846793005ULL + 1442695040888963407ULL;
+    return (uint32_t)(random_state >> 32);
+}
+
+// parse_float must round exactly like strtof. The same text is also
+// parsed through parse_float_range with the end just before a digit, so
+// the bound has to stop it.
+static int float_mismatches = 0;
+
+static void check_float_text(const char *text) {
+    float expected = strtof(text, NULL);
+    float parsed = parse_float(text);
+    size_t len = strlen(text);
+    char bounded[512];
+    float ranged = 0.0f;
+    if (len + 1 < sizeof(bounded)) {
+        memcpy(bounded, text, len);
+        bounded[len] = '7';
+        parse_float_range(bounded, bounded + len, &ranged);
+    } else {
+        ranged = expected;
+    }
+    if (memcmp(&expected, &parsed, sizeof(float)) != 0 || memcmp(&expected, &ranged, sizeof(float)) != 0) {
+        if (float_mismatches++ < 10) fprintf(stderr, "parse_float(\"%s\") = %.9g, strtof gives %.9g\n", text, parsed, expected);
+    }
+}
+
+static void check_parse_float(void) {
+    static const char *boundaries[] = {
+        "0", "-0", "+0.0", "0e99", "1", "-1", ".5", "5.", "+.5e+3", "1E5", "1e-0",
+        "0.1", "0.2", "0.3", "3.14159265358979323846", "1e22", "1e23", "9007199254740993",
+        "16777216", "16777217", "16777218", "16777219", "8510956337525315e6", "6986991688609123e-17", "33554435", "-16777217",
+        "3.4028234e38", "3.40282347e38", "3.4028235e38", "3.40282357e38", "3.4028236e38", "1e39", "-1e39",
+        "1.17549435e-38", "1.1754942e-38", "1.4e-45", "1.401298464e-45", "7.006492321624085e-46",
+        "7.006492321624086e-46", "7e-46", "1e-50", "0.000000000000000000000000000000000000001",
+        "123456789012345678901234567890", "1234567890123456789", "12345678901234567890",
+        "0.00000000000000000000000000000000000000000000140129846432481707092372958328991613128026194187651577175706828388979108268586060148663818836212158203125",
+        "16777217.000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000001",
+        "16777216.999999999999999999999999999999999999999999999999999999999999999999999999999999999999999999999999999999999999999999999999999",
+        "1e100000", "1e-100000", "00000000000000000000000000001.5", "1.50000000000000000000000000000000",
+    };
+    for (size_t i = 0; i < sizeof(boundaries) / sizeof(boundaries[0]); i++) check_float_text(boundaries[i]);
+
+    char text[128];
+    for (int i = 0; i < 200000; i++) {
+        uint32_t bits = next_random();
+        float value;
+        memcpy(&value, &bits, sizeof(value));
+        if (value != value || value - value != 0.0f) continue;
+        switch (i % 6) {
+            case 0: snprintf(text, sizeof(text), "%.9g", value); break;
+            case 1: snprintf(text, sizeof(text), "%.6g", value); break;
+            case 2: snprintf(text, sizeof(text), "%.17g", (double)value); break;
+            case 3: {
+                // Halfway to the next float, and just either side of it.
+                float next = nextafterf(value, value < 0.0f ? -INFINITY : INFINITY);
+                if (next - next != 0.0f) continue;
+                double middle = ((double)value + (double)next) / 2.0;
+                snprintf(text, sizeof(text), "%.40e", middle);
+                check_float_text(text);
+                snprintf(text, sizeof(text), "%.17e", nextafter(middle, 0.0));
+                check_float_text(text);
+                snprintf(text, sizeof(text), "%.17e", nextafter(middle, middle * 2.0));
+                break;
+            }
+            case 4: {
+                // Midpoints cut to 15 or 16 digits: often not a midpoint
+                // any more, yet the nearest double is one.
+                float next = nextafterf(value, value < 0.0f ? -INFINITY : INFINITY);
+                if (next - next != 0.0f) continue;
+                double middle = ((double)value + (double)next) / 2.0;
+                snprintf(text, sizeof(text), "%.15e", middle);
+                check_float_text(text);
+                snprintf(text, sizeof(text), "%.14e", middle);
+                break;
+            }
+            default: {
+                // Random digits with the decimal point and exponent anywhere.
+                int digits = 1 + (int)(next_random() % 30), dot = (int)(next_random() % (unsigned)(digits + 1));
+                size_t len = 0;
+                if (next_random() & 1) text[len++] = '-';
+                for (int d = 0; d < digits; d++) {
+                    if (d == dot) text[len++] = '.';
+                    text[len++] = (char)('0' + next_random() % 10);
+                }
+                snprintf(text + len, sizeof(text) - len, "e%d", (int)(next_random() % 100) - 50);
+                break;
+            }
+        }
+        check_float_text(text);
+    }
+    CHECK(float_mismatches == 0);
+}
+
+// A 200x200 quad grid with random heights. With a small smoothing angle
+// almost every corner gets its own normal, so the deduplicated 40401
+// vertices grow past 65536 while normals are generated.
+static const char *write_jagged_grid(void) {
+    const char *path = "check_grid.obj";
+    FILE *file = fopen(path, "wb");
+    if (!file) {
+        fprintf(stderr, "Failed to create %s\n", path);
+        exit(1);
+    }
+    const int n = 200;
+    unsigned int seed = 12345;
+    for (int y = 0; y <= n; y++) {
+        for (int x = 0; x <= n; x++) {
+            seed = seed * 1664525u + 1013904223u;
+            fprintf(file, "v %d %d %.3f\n", x, y, (float)(seed >> 8) / (float)(1 << 24) * 4.0f);
+        }
+    }
+    for (int y = 0; y < n; y++) {
+        for (int x = 0; x < n; x++) {
+            int a = y * (n + 1) + x + 1, b = a + 1, c = a + n + 1, d = c + 1;
+            fprintf(file, "f %d %d %d\nf %d %d %d\n", a, b, d, a, d, c);
+        }
+    }
+    fclose(file);
+    return path;
+}
+
+// The index width must follow the vertex count after generated normals
+// split vertices, not the count parsed from the file.
+static void check_index_width_after_normals(void) {
+    const char *path = write_jagged_grid();
+    ObjLoadOptions options = {0};
+    options.flags = FIREF_LOAD_NO_CACHE | FIREF_LOAD_DEDUPLICATE | FIREF_LOAD_GENERATE_NORMALS;
+    options.smoothing_angle = 20.0f;
+
+    Obj wide, narrow;
+    ObjLoadStatus status;
+    CHECK(load_obj_batch_ex(&path, 1, &options, &wide, &status, 1) == 0);
+    size_t vertex_total = wide.vertex_count / wide.stride;
+    CHECK(vertex_total > 65536);
+
+    options.index_format = OBJ_INDEX_AUTO;
+    CHECK(load_obj_batch_ex(&path, 1, &options, &narrow, &status, 1) == 0);
+    CHECK(narrow.index_size == 4);
+    CHECK(narrow.index_count == wide.index_count);
+    if (narrow.index_size == 4 && narrow.index_count == wide.index_count) {
+        CHECK(memcmp(narrow.indices, wide.indices, wide.index_count * sizeof(unsigned int)) == 0);
+    }
+    free_obj(&narrow);
+    free_obj(&wide);
+
+    options.index_format = OBJ_INDEX_16;
+    CHECK(load_obj_batch_ex(&path, 1, &options, &narrow, &status, 1) == 1);
+    CHECK(status == OBJ_LOAD_PARSE_FAILED);
+    remove(path);
+}
+
+// Splitting vertices only touches whole triangles; corners past the last
+// one keep their vertex, also when the indices have to widen to 32 bits.
+static void check_split_partial_triangle(void) {
+    const char *path = write_jagged_grid();
+    ObjLoadOptions options = {0};
+    options.flags = FIREF_LOAD_NO_CACHE | FIREF_LOAD_DEDUPLICATE;
+    options.index_format = OBJ_INDEX_AUTO;
+    Obj mesh = load_obj_ex(path, &options);
+    remove(path);
+    CHECK(mesh.index_size == 2);
+    if (mesh.index_size != 2) {
+        free_obj(&mesh);
+        return;
+    }
+
+    mesh.index_count -= 1;
+    uint16_t tail[2] = { mesh.indices16[mesh.index_count - 2], mesh.indices16[mesh.index_count - 1] };
+    CHECK(obj_generate_normals(&mesh, 20.0f, OBJ_NORMALS_ANGLE_WEIGHTED, 1) == 0);
+    CHECK(mesh.index_size == 4);
+    if (mesh.index_size == 4) {
+        CHECK(mesh.indices[mesh.index_count - 2] == tail[0]);
+        CHECK(mesh.indices[mesh.index_count - 1] == tail[1]);
+    }
+    free_obj(&mesh);
+}
+
+// Closest hit over every triangle, for comparison with the BVH traversal.
+static int trace_all(const ObjBvh *bvh, const float origin[3], const float dir[3], ObjRayHit *hit) {
+    int found = 0;
+    float t_max = FLT_MAX;
+    for (size_t i = 0; i < bvh->triangle_count; i++) {
+        if (!firef_ray_triangle(bvh->positions + i * 9, origin, dir, t_max, hit)) continue;
+        t_max = hit->t;
+        found = 1;
+    }
+    return found;
+}
+
+// Vertical rays through the grid lines lie on the face planes of the node
+// boxes. Whatever the sign of their zero direction components, the BVH has
+// to find the closest hit that a test against every triangle finds, up to
+// rounding where several triangles share the hit point.
+static void check_bvh_face_rays(void) {
+    const char *path = write_jagged_grid();
+    ObjLoadOptions options = {0};
+    options.flags = FIREF_LOAD_NO_CACHE;
+    Obj mesh = load_obj_ex(path, &options);
+    remove(path);
+    ObjBvh bvh;
+    CHECK(obj_build_bvh(&mesh, 1, &bvh) == 0);
+
+    int mismatches = 0;
+    for (int i = 0; i < 2000; i++) {
+        float line = (float)(next_random() % 201);
+        float along = (float)(next_random() % 20000) / 100.0f;
+        float origin[3] = { line, along, 10.0f };
+        if (i & 1) {
+            origin[0] = along;
+            origin[1] = line;
+        }
+        for (int signs = 0; signs < 4; signs++) {
+            float dir[3] = { signs & 1 ? -0.0f : 0.0f, signs & 2 ? -0.0f : 0.0f, -1.0f };
+            ObjRayHit expected, hit;
+            int expected_found = trace_all(&bvh, origin, dir, &expected);
+            int found = obj_bvh_intersect(&bvh, origin, dir, FLT_MAX, &hit);
+            if (found != expected_found || (found && fabsf(hit.t - expected.t) > 1e-5f * expected.t)) mismatches++;
+            if (obj_bvh_occluded(&bvh, origin, dir, FLT_MAX) != expected_found) mismatches++;
+        }
+    }
+    CHECK(mismatches == 0);
+    free_bvh(&bvh);
+    free_obj(&mesh);
+}
+
+static size_t append(char *buffer, size_t len, size_t cap, const char *text) {
+    size_t n = strlen(text);
+    if (len + n < cap) {
+        memcpy(buffer + len, text, n);
+        len += n;
+    }
+    return len;
+}
+
+static const char *random_space(void) {
+    static const char *spaces[] = { " ", " ", " ", "\t", "  ", " \t", "\v", "\f ", "\r " };
+    return spaces[next_random() % (sizeof(spaces) / sizeof(spaces[0]))];
+}
+
+// A valid OBJ that mixes every record with odd whitespace, keywords that
+// only look like records, empty records, faces with more corners than are
+// kept and a missing last newline.
+static size_t write_random_obj(char *buffer, size_t cap) {
+    static const char *junk[] = {
+        "# v 1 2 3", "vp 1 2", "v1 2 3", "ff 1 2 3", "vtx 1", "vnn 1 2 3", "f", "v", "g", "g group name",
+        "o object", "s 1", "usemtl stone", "", "   ", "\r", "\t\t"
+    };
+    char text[64];
+    size_t len = 0;
+    int v = 0, vt = 0, vn = 0;
+    int lines = 200 + (int)(next_random() % 400);
+
+    for (int line = 0; line < lines; line++) {
+        if (next_random() % 4 == 0) len = append(buffer, len, cap, random_space());
+        unsigned int kind = next_random() % 100;
+        if (kind < 30 || v == 0) {
+            len = append(buffer, len, cap, "v");
+            int values = (int)(next_random() % 5);
+            for (int i = 0; i < values || i == 0; i++) {
+                len = append(buffer, len, cap, random_space());
+                if (i < values) {
+                    snprintf(text, sizeof(text), "%d.%03u", (int)(next_random() % 200) - 100, next_random() % 1000);
+                    len = append(buffer, len, cap, text);
+                }
+            }
+            v++;
+        } else if (kind < 40) {
+            len = append(buffer, len, cap, next_random() % 8 ? "vt 0.25 0.75" : "vt");
+            vt++;
+        } else if (kind < 50) {
+            len = append(buffer, len, cap, next_random() % 8 ? "vn\t0 1 0" : "vn");
+            vn++;
+        } else if (kind < 80) {
+            len = append(buffer, len, cap, "f");
+            int corners = (int)(next_random() % 41);
+            for (int i = 0; i < corners; i++) {
+                len = append(buffer, len, cap, random_space());
+                int index = 1 + (int)(next_random() % (unsigned)v);
+                if (next_random() & 1) index = index - v - 1;
+                unsigned int form = next_random() % 4;
+                int t = vt && (form & 1) ? 1 + (int)(next_random() % (unsigned)vt) : 0;
+                int n = vn && (form & 2) ? 1 + (int)(next_random() % (unsigned)vn) : 0;
+                if (t && n) snprintf(text, sizeof(text), "%d/%d/%d", index, t, n);
+                else if (t) snprintf(text, sizeof(text), "%d/%d", index, t);
+                else if (n) snprintf(text, sizeof(text), "%d//%d", index, n);
+                else snprintf(text, sizeof(text), "%d", index);
+                len = append(buffer, len, cap, text);
+            }
+        } else {
+            len = append(buffer, len, cap, junk[next_random() % (sizeof(junk) / sizeof(junk[0]))]);
+        }
+        if (line < lines - 1 || next_random() % 2) len = append(buffer, len, cap, next_random() % 8 ? "\n" : "\r\n");
+    }
+    return len;
+}
+
+static int same_mesh(const Obj *a, const Obj *b) {
+    if (a->vertex_count != b->vertex_count || a->index_count != b->index_count || a->index_size != b->index_size) return 0;
+    if (memcmp(a->vertices, b->vertices, a->vertex_count * sizeof(float)) != 0) return 0;
+    return memcmp(a->indices, b->indices, a->index_count * a->index_size) == 0;
+}
+
+// FIREF_LOAD_EXACT_SIZE must store exactly what its count pass counted:
+// the count of every slice matches what parsing it stores, and exact
+// loads equal default ones on 1, 2 and 8 threads.
+static void check_exact_size(void) {
+    static const unsigned int flag_sets[] = {
+        0, FIREF_LOAD_DEDUPLICATE, FIREF_LOAD_POSITIONS | FIREF_LOAD_NORMALS, FIREF_LOAD_UVS | FIREF_LOAD_DEDUPLICATE
+    };
+    static const int thread_counts[] = { 1, 2, 8 };
+    size_t cap = 1 << 20;
+    char *text = (char*)malloc(cap);
+    int count_mismatches = 0, load_mismatches = 0;
+
+    for (int file = 0; file < 40; file++) {
+        size_t size = write_random_obj(text, cap);
+        const char *end = text + size;
+
+        for (int slice = 0; slice < 20; slice++) {
+            const char *begin = text + next_random() % (size + 1);
+            const char *stop = begin + next_random() % (size_t)(end - begin + 1);
+            if (begin != text) {
+                const char *eol = (const char*)memchr(begin, '\n', (size_t)(end - begin));
+                begin = eol ? eol + 1 : end;
+            }
+            if (stop < begin) stop = begin;
+            if (stop != end) {
+                const char *eol = (const char*)memchr(stop, '\n', (size_t)(end - stop));
+                stop = eol ? eol + 1 : end;
+            }
+
+            FirefChunk chunk;
+            FirefAssembly a;
+            memset(&chunk, 0, sizeof(chunk));
+            memset(&a, 0, sizeof(a));
+            a.chunks = &chunk;
+            a.chunk_count = 1;
+            chunk.begin = begin;
+            chunk.end = stop;
+            chunk.attributes = firef_attribute_mask(flag_sets[slice % 4]);
+            firef_count_chunk(&a, 0);
+            size_t counted[5] = { chunk.pos_cap, chunk.uv_cap, chunk.norm_cap, chunk.corner_cap, chunk.face_cap };
+            chunk.pos_cap = chunk.uv_cap = chunk.norm_cap = chunk.corner_cap = chunk.face_cap = 0;
+            firef_parse_chunk(&a, 0);
+            size_t parsed[5] = {
+                (chunk.attributes & FIREF_LOAD_POSITIONS) ? chunk.pos_len : 0, chunk.uv_len, chunk.norm_len,
+                chunk.corner_len, chunk.face_len
+            };
+            if (chunk.status == 0 && memcmp(counted, parsed, sizeof(counted)) != 0) count_mismatches++;
+            firef_free_chunk(&chunk);
+        }
+
+        for (int f = 0; f < 4; f++) {
+            for (int t = 0; t < 3; t++) {
+                ObjLoadOptions options = {0};
+                options.flags = flag_sets[f];
+                options.threads = thread_counts[t];
+                Obj grown, exact;
+                int grown_status = firef_parse_obj(text, size, &options, NULL, &grown);
+                options.flags |= FIREF_LOAD_EXACT_SIZE;
+                int exact_status = firef_parse_obj(text, size, &options, NULL, &exact);
+                if (grown_status != 0 || exact_status != 0 || !same_mesh(&grown, &exact)) load_mismatches++;
+                if (grown_status == 0) free_obj(&grown);
+                if (exact_status == 0) free_obj(&exact);
+            }
+        }
+    }
+    free(text);
+    CHECK(count_mismatches == 0);
+    CHECK(load_mismatches == 0);
+}
+
+// Starts a tokenizer on [begin, end) that splits blocks with scan.
+static void start_tokenizer(FirefTokenizer *t, const char *begin, const char *end, FirefScanBlock scan) {
+    firef_tokenizer_init(t, begin, end);
+    t->scan = scan;
+    firef_tokenizer_load(t);
+}
+
+// Whether the scalar tokenizer and one using scan split [begin, end) into
+// the same lines and tokens.
+static int same_tokens(const char *begin, const char *end, FirefScanBlock scan) {
+    FirefTokenizer expected_tokenizer, tokenizer;
+    FirefLine expected, line;
+    start_tokenizer(&expected_tokenizer, begin, end, firef_scan_block_scalar);
+    start_tokenizer(&tokenizer, begin, end, scan);
+    for (;;) {
+        int more = firef_next_line(&expected_tokenizer, &expected);
+        int got = firef_next_line(&tokenizer, &line);
+        if (!more || !got) return more == got;
+        if (line.end != expected.end || line.token_count != expected.token_count) return 0;
+        for (int i = 0; i < line.token_count; i++) {
+            if (line.tokens[i].begin != expected.tokens[i].begin || line.tokens[i].end != expected.tokens[i].end) return 0;
+        }
+    }
+}
+
+// The SSE2 and AVX2 block scanners must mark the same bytes as the scalar
+// one, which FIREF_NO_SIMD builds use, and tokenize the same way with it.
+static void check_simd_tokenizer(void) {
+    FirefScanBlock scans[2];
+    int scan_count = 0;
+#if defined(FIREF_HAS_SSE2)
+    scans[scan_count++] = firef_scan_block_sse2;
+#endif
+#if defined(FIREF_HAS_AVX2)
+    if (firef_cpu_has_avx2()) scans[scan_count++] = firef_scan_block_avx2;
+#endif
+    // Whitespace, its neighbours and bytes that are negative as signed char.
+    static const char edges[] = " \t\n\v\f\r\b\x0e\x1f!\x7f\x80\x89\x8a\x8d\xa0\xff\0v1";
+    int mismatches = 0;
+
+    char block[64];
+    for (int i = 0; i < 20000; i++) {
+        for (int b = 0; b < 64; b++) {
+            block[b] = next_random() & 1 ? (char)next_random() : edges[next_random() % (sizeof(edges) - 1)];
+        }
+        uint64_t space, newline;
+        firef_scan_block_scalar(block, &space, &newline);
+        for (int k = 0; k < scan_count; k++) {
+            uint64_t s, n;
+            scans[k](block, &s, &n);
+            if (s != space || n != newline) mismatches++;
+        }
+    }
+
+    // Exactly sized copies, so reads past the end show up under ASan.
+    for (int i = 0; i < 3000; i++) {
+        size_t len = next_random() % 400;
+        char *text = (char*)malloc(len ? len : 1);
+        for (size_t b = 0; b < len; b++) text[b] = edges[next_random() % (sizeof(edges) - 1)];
+        for (int k = 0; k < scan_count; k++) {
+            if (!same_tokens(text, text + len, scans[k])) mismatches++;
+        }
+        free(text);
+    }
+
+    size_t cap = 1 << 20;
+    char *obj = (char*)malloc(cap);
+    for (int file = 0; file < 10; file++) {
+        size_t size = write_random_obj(obj, cap);
+        for (int k = 0; k < scan_count; k++) {
+            if (!same_tokens(obj, obj + size, scans[k])) mismatches++;
+        }
+    }
+    free(obj);
+    CHECK(mismatches == 0);
+}
+
+int main(void) {
+    check_parse_float();
+    check_exact_size();
+    check_simd_tokenizer();
+    check_index_width_after_normals();
+    check_split_partial_triangle();
+    check_bvh_face_rays();
+    if (failures) {
+        fprintf(stderr, "%d check(s) failed\n", failures);
+        return 1;
+    }
+    printf("All checks passed\n");
+    return 0;
+}
@@ -5,25 +5,599 @@
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h> 
+#include <limits.h>
+#include <stdint.h>
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+typedef enum {
+    OBJ_LAYOUT_AOS, // vertices: interleaved pos.xyz, uv.xy, normal.xyz
+    OBJ_LAYOUT_SOA  // positions, uvs, normals: one aligned stream each
+} ObjLayout;
+
+#define FIREF_SOA_ALIGNMENT 64
+
+typedef enum {
+    OBJ_INDEX_32,   // unsigned int indices
+    OBJ_INDEX_AUTO, // 16-bit whenever every vertex fits, 32-bit otherwise
+    OBJ_INDEX_16    // 16-bit; loading fails above 65536 vertices
+} ObjIndexFormat;
+
+// Bounds of every v record in the file, computed while parsing. The sphere
+// encloses all positions but is not the minimal one; the centroid is their
+// mean. All zero when positions were not loaded.
+typedef struct {
+    float min[3], max[3];
+    float center[3];
+    float radius;
+    float centroid[3];
+} ObjBounds;
+
+// Linear allocator. Allocations bump a cursor through the caller's buffer
+// (which may be NULL), then through blocks from FIREF_MALLOC; nothing is
+// freed on its own. obj_arena_reset releases everything at once, keeping
+// the buffer and the newest block for reuse; obj_arena_free also returns
+// that block. Allocation is thread-safe. peak is the most bytes ever in
+// use, a good size for the buffer.
+typedef struct {
+    unsigned char *buffer;
+    size_t buffer_size;
+    void *blocks;
+    void *spare;
+    unsigned char *cursor, *limit;
+    size_t used, peak;
+    uint64_t lock;
+} ObjArena;
+
 typedef struct {
     float *vertices;
     size_t vertex_count;
 
+    // Bytes per index. With 4, indices holds the index buffer; with 2,
+    // indices16 holds it and indices is NULL.
     unsigned int *indices;
     size_t index_count;
+    unsigned int index_size;
+    uint16_t *indices16;
+
+    // Floats per vertex and the FIREF_LOAD_* attributes they hold, in
+    // position, uv, normal, tangent order: 8 and the first three unless the
+    // load was restricted or asked for tangents. There are
+    // vertex_count / stride vertices in either layout.
+    unsigned int stride;
+    unsigned int attributes;
+
+    // With OBJ_LAYOUT_SOA vertices is NULL and every loaded attribute has
+    // its own FIREF_SOA_ALIGNMENT-aligned stream instead; vertex_count
+    // still counts floats. Streams of attributes not loaded are NULL.
+    ObjLayout layout;
+    float *positions;
+    float *uvs;
+    float *normals;
+    float *tangents;
+
+    ObjBounds bounds;
+
+    // Arena the buffers above live in, NULL when they are on the heap.
+    ObjArena *arena;
 } Obj;
 
+// ObjLoadOptions.flags
+// Reuse one output vertex for every face corner with the same v/vt/vn
+// index triple instead of emitting a new vertex per corner.
+#define FIREF_LOAD_DEDUPLICATE (1u << 0)
+// load_obj_ex reuses a fresh "<path>.firefbin" sidecar holding the final
+// vertices and indices instead of parsing the text. A sidecar is fresh
+// when the source size, mtime (with nanoseconds where the platform has
+// them) and a hash of all of its bytes match, and so do the load flags.
+// These two flags control it: never look at the sidecar, and (re)write it
+// after a successful parse.
+#define FIREF_LOAD_NO_CACHE    (1u << 1)
+#define FIREF_LOAD_WRITE_CACHE (1u << 2)
+// Attributes to load; all three when none is set. Records and face
+// indices of other attributes are skipped without being parsed and the
+// output vertex shrinks to the selected attributes (see Obj.stride).
+#define FIREF_LOAD_POSITIONS   (1u << 3)
+#define FIREF_LOAD_UVS         (1u << 4)
+#define FIREF_LOAD_NORMALS     (1u << 5)
+#define FIREF_LOAD_ALL_ATTRIBUTES (FIREF_LOAD_POSITIONS | FIREF_LOAD_UVS | FIREF_LOAD_NORMALS)
+// When the file has no vn records, fill the normals with smooth normals
+// from obj_generate_normals using ObjLoadOptions.smoothing_angle and
+// normal_weighting instead of zeros.
+#define FIREF_LOAD_GENERATE_NORMALS (1u << 6)
+// Adds a 4-float tangent (xyz plus the bitangent sign in w) after the
+// normal of every vertex and fills it with obj_generate_tangents. Needs
+// uvs and normals.
+#define FIREF_LOAD_TANGENTS (1u << 7)
+// Scans the text once to count the v/vt/vn records and face corners
+// before parsing, then allocates every parse buffer once at its exact
+// size and lets each chunk parse straight into its slice of it. This
+// avoids regrowing and merging the buffers, lowering peak memory, at the
+// cost of the extra scan.
+#define FIREF_LOAD_EXACT_SIZE (1u << 8)
+
+typedef enum {
+    OBJ_NORMALS_ANGLE_WEIGHTED, // by the face angle at each corner
+    OBJ_NORMALS_AREA_WEIGHTED   // by face area
+} ObjNormalWeighting;
+
+typedef struct {
+    unsigned int flags;
+    // Number of threads used to parse a single file. The buffer is split
+    // at line boundaries into one chunk per thread; 0 or 1 parses on the
+    // calling thread.
+    int threads;
+    // Output vertex layout, OBJ_LAYOUT_AOS by default.
+    ObjLayout layout;
+    // Output index width, OBJ_INDEX_32 by default.
+    ObjIndexFormat index_format;
+    // FIREF_LOAD_GENERATE_NORMALS settings, see obj_generate_normals.
+    float smoothing_angle;
+    ObjNormalWeighting normal_weighting;
+    // Optional arena for the temporary buffers of a load, generated normals
+    // and tangents included; it is reset when the load ends, so give every
+    // concurrent load its own. It must differ from output_arena; if both
+    // are the same the temporaries use the heap. The sidecar path strings
+    // and the contents of a file that cannot be mapped stay on the heap.
+    ObjArena *scratch_arena;
+    // Optional arena for the vertex and index buffers of the result, which
+    // free_obj then leaves alone. Functions that later resize them
+    // allocate from it as well.
+    ObjArena *output_arena;
+} ObjLoadOptions;
+
+Obj load_obj(const char *path);
+Obj load_obj_ex(const char *path, const ObjLoadOptions *options);
+// Parses an OBJ that is already in memory. data does not need to be
+// NUL-terminated and is read in place, never modified or retained.
+Obj load_obj_from_memory(const char *data, size_t len);
+Obj load_obj_from_memory_ex(const char *data, size_t len, const ObjLoadOptions *options);
+void free_obj(Obj *obj);
+
+void obj_arena_init(ObjArena *arena, void *buffer, size_t size);
+void obj_arena_reset(ObjArena *arena);
+void obj_arena_free(ObjArena *arena);
+
+typedef enum {
+    OBJ_LOAD_OK,
+    OBJ_LOAD_OPEN_FAILED,
+    OBJ_LOAD_PARSE_FAILED,
+    OBJ_LOAD_CANCELLED
+} ObjLoadStatus;
+
+// Loads count files on a pool of up to threads threads. Files are started
+// biggest first and dealt out round robin; a thread that runs out of work
+// steals the biggest file left in another thread's queue, so reading one
+// file overlaps with parsing others. A file that fails does not stop the
+// batch: its Obj is zeroed and, with the _ex variant, status[i] says why
+// (status may be NULL). options->threads still splits each single file;
+// every worker uses its own scratch arena instead of options->scratch_arena.
+// Returns the number of files that failed.
+size_t load_obj_batch(const char *const *paths, size_t count, Obj *out, int threads);
+size_t load_obj_batch_ex(const char *const *paths, size_t count, const ObjLoadOptions *options, Obj *out, ObjLoadStatus *status, int threads);
+
+// Background load of one file.
+typedef struct ObjLoadJob ObjLoadJob;
+// Runs on the loading thread once the job has finished, failed or been
+// cancelled, before obj_load_poll reports it done. It must not wait on
+// the job itself.
+typedef void (*ObjLoadCallback)(ObjLoadJob *job, ObjLoadStatus status, void *user);
+
+// Starts loading path on a new thread (on the calling thread, before
+// returning, when threads are unavailable). callback may be NULL. Returns
+// NULL when out of memory. Every job must be finished with obj_load_wait.
+ObjLoadJob *load_obj_async(const char *path, const ObjLoadOptions *options, ObjLoadCallback callback, void *user);
+// 1 once the job is done, 0 while it is running.
+int obj_load_poll(const ObjLoadJob *job);
+// Fraction of the file parsed so far, from 0 to 1.
+float obj_load_progress(const ObjLoadJob *job);
+// Asks the job to stop; parsing notices within the next 64 KB of input.
+// The job still has to be finished with obj_load_wait.
+void obj_load_cancel(ObjLoadJob *job);
+// Blocks until the job is done, moves the mesh to out (zeroed unless the
+// status is OBJ_LOAD_OK) and frees the job.
+ObjLoadStatus obj_load_wait(ObjLoadJob *job, Obj *out);
+
+// Face corner passed to ObjStreamCallbacks.face: 0-based indices with
+// negative (relative) references already resolved, always below the
+// number of records of their kind passed so far; -1 when absent or out
+// of range. A face whose position is out of range fails the stream, so
+// faces can only use positions that come before them.
+typedef struct {
+    long v, t, n;
+} ObjFaceCorner;
+
+// SAX-style callbacks for stream_obj. Any callback may be NULL, in which
+// case its records are skipped without parsing their numbers. A nonzero
+// return value stops parsing and is returned from stream_obj.
+typedef struct {
+    void *user;
+    int (*position)(void *user, float x, float y, float z);
+    int (*texcoord)(void *user, float u, float v);
+    int (*normal)(void *user, float x, float y, float z);
+    int (*face)(void *user, const ObjFaceCorner *corners, int count);
+    int (*group)(void *user, const char *name, size_t len);
+} ObjStreamCallbacks;
+
+#define FIREF_STREAM_BUFFER_SIZE (64 * 1024)
+
+// Parses an OBJ through a rolling read buffer of buffer_size bytes
+// (FIREF_STREAM_BUFFER_SIZE when 0), so memory use does not depend on the
+// file size. The buffer only grows to fit a single longer line. Returns
+// 0 on success, -1 on I/O or parse errors, or the first nonzero callback
+// result.
+int stream_obj(const char *path, const ObjStreamCallbacks *callbacks, size_t buffer_size);
+int stream_obj_file(FILE *file, const ObjStreamCallbacks *callbacks, size_t buffer_size);
+
+// Post-transform vertex cache efficiency of an index buffer, simulated with
+// a FIFO cache. ACMR is vertex transforms per triangle (3 is the worst,
+// around 0.6 is typical after optimizing a regular mesh), ATVR is
+// transforms per referenced vertex (1 is ideal).
+typedef struct {
+    float acmr_before, acmr_after;
+    float atvr_before, atvr_after;
+} ObjCacheStats;
+
+void obj_analyze_vertex_cache(const Obj *obj, unsigned int cache_size, float *acmr, float *atvr);
+// Reorders the triangles in obj->indices for a vertex cache of cache_size
+// entries using Tipsify (Sander et al. 2007), which runs in linear time.
+// Vertices and triangle winding are unchanged. stats may be NULL.
+// Returns 0 on success, -1 when out of memory or an index is out of
+// range (obj is left untouched).
+int obj_optimize_vertex_cache(Obj *obj, unsigned int cache_size, ObjCacheStats *stats);
+// Renumbers vertices in the order obj->indices first references them and
+// moves the vertex data to match, so vertex fetch walks memory mostly
+// forward. Unreferenced vertices keep their relative order at the end.
+// remap (vertex_count / stride entries, may be NULL) receives the new
+// index of every old vertex so side data can be permuted the same way.
+// Returns 0 on success, -1 when out of memory or an index is out of range.
+int obj_optimize_vertex_fetch(Obj *obj, unsigned int *remap);
+
+// Packed vertex encodings for obj_pack_vertices. HALF and UNORM16 positions
+// are stored relative to the mesh bounds and padded to four components
+// (8 bytes); decode them with position_origin + position_scale * value,
+// reading HALF as a float in [-1, 1] and UNORM16 as a normalized [0, 1]
+// value. OCT16 normals are two snorm16 octahedral coordinates, 1010102
+// normals are snorm x/y/z in bits 0-9/10-19/20-29 of a 32-bit word.
+typedef enum {
+    OBJ_POSITION_FLOAT,  // 3 floats, 12 bytes
+    OBJ_POSITION_HALF,   // 4 half floats, 8 bytes
+    OBJ_POSITION_UNORM16 // 4 unorm16, 8 bytes
+} ObjPositionFormat;
+
+typedef enum {
+    OBJ_UV_FLOAT, // 2 floats, 8 bytes
+    OBJ_UV_HALF   // 2 half floats, 4 bytes
+} ObjUvFormat;
+
+typedef enum {
+    OBJ_NORMAL_FLOAT,   // 3 floats, 12 bytes
+    OBJ_NORMAL_OCT16,   // 2 snorm16, 4 bytes
+    OBJ_NORMAL_1010102  // 10:10:10:2 snorm, 4 bytes
+} ObjNormalFormat;
+
+typedef struct {
+    unsigned char *data;
+    size_t vertex_count;
+    unsigned int stride; // bytes per vertex, a multiple of 4
+
+    // Byte offset of each attribute within a vertex, -1 when not loaded.
+    int position_offset, uv_offset, normal_offset;
+    ObjPositionFormat position_format;
+    ObjUvFormat uv_format;
+    ObjNormalFormat normal_format;
+
+    float position_origin[3];
+    float position_scale[3];
+} ObjPackedVertices;
+
+// Encodes the vertices of obj (either layout) into one interleaved buffer,
+// e.g. 16 bytes per vertex for UNORM16 + HALF + OCT16 instead of 32.
+// obj's index buffer applies unchanged. Returns 0 on success, -1 when out
+// of memory.
+int obj_pack_vertices(const Obj *obj, ObjPositionFormat position, ObjUvFormat uv, ObjNormalFormat normal, ObjPackedVertices *out);
+void free_packed_vertices(ObjPackedVertices *packed);
+
+// Cluster limits used when obj_build_meshlets gets 0, and the largest it
+// accepts (local indices are bytes).
+#define FIREF_MESHLET_VERTICES 64
+#define FIREF_MESHLET_TRIANGLES 124
+#define FIREF_MESHLET_VERTEX_LIMIT 255
+#define FIREF_MESHLET_TRIANGLE_LIMIT 512
+
+// One cluster: vertex_count entries of ObjMeshlets.vertices from
+// vertex_offset, and triangle_count triangles of 3 local vertex numbers in
+// ObjMeshlets.triangles from triangle_offset. The cluster is backfacing
+// for a camera at eye, and can be culled, when
+// dot(normalize(cone_apex - eye), cone_axis) > cone_cutoff. Clusters
+// that can never be culled get a zero cone_axis and a cutoff of 1.
+typedef struct {
+    unsigned int vertex_offset;
+    unsigned int triangle_offset;
+    unsigned int vertex_count;
+    unsigned int triangle_count;
+
+    float center[3];
+    float radius;
+    float cone_apex[3];
+    float cone_axis[3];
+    float cone_cutoff;
+} ObjMeshlet;
+
+typedef struct {
+    ObjMeshlet *meshlets;
+    size_t meshlet_count;
+    unsigned int *vertices; // indices into the mesh's vertices
+    size_t vertex_count;
+    unsigned char *triangles;
+    size_t triangle_count;
+} ObjMeshlets;
+
+// Splits the triangles of obj into clusters of at most max_vertices and
+// max_triangles, growing each one greedily through shared vertices, and
+// computes a bounding sphere and normal cone per cluster. Only meshes
+// that share vertices (FIREF_LOAD_DEDUPLICATE) form real clusters. Returns
+// 0 on success, -1 on bad limits, out of range indices or out of memory.
+int obj_build_meshlets(const Obj *obj, unsigned int max_vertices, unsigned int max_triangles, ObjMeshlets *out);
+void free_meshlets(ObjMeshlets *meshlets);
+
+// Flat BVH node, 32 bytes. Nodes are stored depth first: an inner node
+// (count == 0) has its left child right after it and its right child at
+// index first; a leaf covers count triangles of ObjBvh.triangles from first.
+typedef struct {
+    float min[3];
+    unsigned int first;
+    float max[3];
+    unsigned int count;
+} ObjBvhNode;
+
+// triangles maps leaf order to triangle numbers in the mesh (index / 3),
+// and positions holds the 9 corner coordinates of each of them in that
+// order, so queries never touch the mesh.
+typedef struct {
+    ObjBvhNode *nodes;
+    size_t node_count;
+    unsigned int *triangles;
+    float *positions;
+    size_t triangle_count;
+} ObjBvh;
+
+typedef struct {
+    float t;            // distance along the ray in units of dir
+    float u, v;         // barycentrics of corners 1 and 2
+    unsigned int triangle;
+} ObjRayHit;
+
+// Builds a BVH over the triangles of obj with binned SAH splits. The top
+// levels are split on the calling thread and the subtrees below them are
+// built on up to threads threads (1 or less builds serially). Needs
+// positions. Returns 0 on success, -1 without positions, on out of range
+// indices or when out of memory.
+int obj_build_bvh(const Obj *obj, int threads, ObjBvh *out);
+void free_bvh(ObjBvh *bvh);
+// Closest hit of the ray origin + t * dir with t in [0, t_max]. Returns 1
+// and fills hit, or 0 when nothing is hit. Culls no faces.
+int obj_bvh_intersect(const ObjBvh *bvh, const float origin[3], const float dir[3], float t_max, ObjRayHit *hit);
+// Any-hit variant for visibility: 1 when something blocks the segment.
+int obj_bvh_occluded(const ObjBvh *bvh, const float origin[3], const float dir[3], float t_max);
+
+// Replaces the normals of obj with smooth vertex normals. Vertices are
+// welded by position, so faces that share a position share its normal
+// even when the file gives them separate vertices. Faces meeting at more
+// than smoothing_angle degrees keep separate normals, which may add
+// vertices (and switch 16-bit indices to 32-bit when they no longer fit);
+// 0 or 180 smooths across every edge. Positions are gathered per output,
+// so the work splits across threads without write conflicts. Needs
+// positions and normals. Returns 0 on success, -1 when out of memory or an
+// index is out of range.
+int obj_generate_normals(Obj *obj, float smoothing_angle, ObjNormalWeighting weighting, int threads);
+// Fills per-vertex tangents (Obj.tangents, or the 4 floats after the
+// normal) in a MikkTSpace-like way, not bit-compatible with the reference
+// implementation: the uv gradient of each triangle is projected onto the
+// vertex normal, angle weighted and summed over corners that share
+// position, uv and normal and have the same uv winding. There is no
+// grouping by connectivity as in MikkTSpace, so baked normal maps can
+// differ slightly. w is the bitangent sign, so bitangent = w *
+// cross(normal, tangent). Adds the tangent slot when obj has none, and
+// clones vertices shared by mirrored uv islands. Runs over triangles, then
+// corners, on up to threads threads. Needs positions, uvs and normals.
+// Returns 0 on success, -1 otherwise.
+int obj_generate_tangents(Obj *obj, int threads);
+
+// One level of detail: a triangle list over the vertices of the source
+// mesh (always 32-bit), so all levels share its vertex buffer. error is
+// the largest distance of the simplified surface from the original,
+// estimated from the quadrics, in model units.
+typedef struct {
+    unsigned int *indices;
+    size_t index_count;
+    float error;
+} ObjLod;
+
+typedef struct {
+    ObjLod *levels;
+    size_t level_count;
+} ObjLodChain;
+
+// Simplifies obj with quadric error edge collapses until at most
+// ratio * triangles remain, or until the next collapse would move the
+// surface by more than max_error times the mesh extent (1 or more for no
+// limit). Vertices are welded first, so meshes loaded without
+// FIREF_LOAD_DEDUPLICATE simplify too. seams picks the attributes
+// (FIREF_LOAD_UVS, FIREF_LOAD_NORMALS, FIREF_LOAD_TANGENTS) whose
+// differences make seams; vertices that differ only in the others are
+// merged and one of them is kept, e.g. pass FIREF_LOAD_UVS for flat shaded
+// scans whose normals get regenerated. Seams and open borders only
+// collapse along themselves, and collapses that flip a triangle are
+// rejected. Needs positions. Returns 0 on success, -1 on out of range
+// indices or when out of memory.
+int obj_simplify(const Obj *obj, float ratio, float max_error, unsigned int seams, ObjLod *out);
+// Same for a chain of decreasing ratios of the original triangle count;
+// each level continues from the previous one, so errors only grow.
+int obj_build_lods(const Obj *obj, const float *ratios, size_t ratio_count, float max_error, unsigned int seams, ObjLodChain *out);
+void free_lod(ObjLod *lod);
+void free_lod_chain(ObjLodChain *chain);
+
+static const double firef_pow10[23] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+#define FIREF_IS_DIGIT(c) ((unsigned)((c) - '0') < 10u)
+
+// Locale-independent decimal float parser for [s, end). Accepts an optional
+// sign, digits with an optional '.', and an optional e/E exponent; leading
+// whitespace is not skipped. end may be NULL for NUL-terminated input.
+// Returns the position after the number, or s if no number starts there.
+//
+// The result is correctly rounded. Numbers with at most 19 significant
+// digits and a small exponent are computed exactly in double; anything
+// else is handed to strtof as a radix-free "<digits>e<exp>" string.
+static inline const char *parse_float_range(const char *s, const char *end, float *out) {
+    const char *p = s;
+    int negative = 0;
+    if (p != end && (*p == '-' || *p == '+')) {
+        negative = *p == '-';
+        p++;
+    }
+
+    const char *int_start = p;
+    while (p != end && FIREF_IS_DIGIT(*p)) p++;
+    const char *int_end = p;
+    const char *frac_start = p, *frac_end = p;
+    if (p != end && *p == '.') {
+        frac_start = ++p;
+        while (p != end && FIREF_IS_DIGIT(*p)) p++;
+        frac_end = p;
+    }
+    if (int_start == int_end && frac_start == frac_end) return s;
+
+    long exponent = 0;
+    if (p != end && (*p == 'e' || *p == 'E')) {
+        const char *q = p + 1;
+        int exp_negative = 0;
+        if (q != end && (*q == '-' || *q == '+')) {
+            exp_negative = *q == '-';
+            q++;
+        }
+        if (q != end && FIREF_IS_DIGIT(*q)) {
+            while (q != end && FIREF_IS_DIGIT(*q)) {
+                if (exponent < 100000) exponent = exponent * 10 + (*q - '0');
+                q++;
+            }
+            if (exp_negative) exponent = -exponent;
+            p = q;
+        }
+    }
+
+    unsigned long long mantissa = 0;
+    int significant = 0, truncated = 0;
+    long e10 = exponent;
+    for (const char *q = int_start; q != int_end; q++) {
+        if (significant < 19) {
+            mantissa = mantissa * 10 + (unsigned)(*q - '0');
+            if (mantissa) significant++;
+        } else {
+            e10++;
+            if (*q != '0') truncated = 1;
+        }
+    }
+    for (const char *q = frac_start; q != frac_end; q++) {
+        if (significant < 19) {
+            mantissa = mantissa * 10 + (unsigned)(*q - '0');
+            if (mantissa) significant++;
+            e10--;
+        } else if (*q != '0') {
+            truncated = 1;
+        }
+    }
+
+    if (mantissa == 0 && !truncated) {
+        *out = negative ? -0.0f : 0.0f;
+        return p;
+    }
+
+    if (!truncated && mantissa <= (1ULL << 53) && e10 >= -22 && e10 <= 22) {
+        double value = (double)mantissa;
+        value = e10 < 0 ? value / firef_pow10[-e10] : value * firef_pow10[e10];
+
+        // The double is correctly rounded, so narrowing it is too unless it
+        // landed exactly halfway between two floats.
+        unsigned long long bits;
+        memcpy(&bits, &value, sizeof(bits));
+        if ((bits & 0x1FFFFFFFULL) != 0x10000000ULL) {
+            *out = negative ? -(float)value : (float)value;
+            return p;
+        }
+    }
+
+    // Slow path: up to 119 significant digits plus a sticky digit are
+    // enough to decide the rounding of any float.
+    char buffer[160];
+    size_t len = 0;
+    long dropped = 0;
+    int sticky = 0;
+    for (const char *q = int_start; q != frac_end; q++) {
+        if (q == int_end) {
+            q = frac_start;
+            if (q == frac_end) break;
+        }
+        if (len == 0 && *q == '0') continue;
+        if (len < 119) {
+            buffer[len++] = *q;
+        } else {
+            if (*q != '0') sticky = 1;
+            dropped++;
+        }
+    }
+    if (sticky) {
+        buffer[len++] = '1';
+        dropped--;
+    }
+    long scale = exponent - (long)(frac_end - frac_start) + dropped;
+    snprintf(buffer + len, sizeof(buffer) - len, "e%ld", scale);
+
+    float value = strtof(buffer, NULL);
+    *out = negative ? -value : value;
+    return p;
+}
+
+// Parses an optionally signed decimal integer from [s, end). end may be
+// NULL for NUL-terminated input. Returns the position after the number,
+// or s if no digits follow the sign.
+static inline const char *parse_int_range(const char *s, const char *end, long *out) {
+    const char *p = s;
+    int negative = 0;
+    if (p != end && (*p == '-' || *p == '+')) {
+        negative = *p == '-';
+        p++;
+    }
+    if (p == end || !FIREF_IS_DIGIT(*p)) return s;
+
+    unsigned long value = 0;
+    while (p != end && FIREF_IS_DIGIT(*p)) {
+        if (value <= (unsigned long)LONG_MAX / 10) value = value * 10 + (unsigned)(*p - '0');
+        p++;
+    }
+    if (value > (unsigned long)LONG_MAX) value = (unsigned long)LONG_MAX;
+    *out = negative ? -(long)value : (long)value;
+    return p;
+}
+
 static inline float parse_float(const char *s) {
-    return strtof(s, NULL);
+    float value = 0.0f;
+    while (isspace((unsigned char)*s)) s++;
+    parse_float_range(s, NULL, &value);
+    return value;
 }
 
 static inline int parse_int(const char *s) {
-    return strtol(s, NULL, 10);
+    long value = 0;
+    while (isspace((unsigned char)*s)) s++;
+    parse_int_range(s, NULL, &value);
+    return (int)value;
 }
 
 #ifdef __cplusplus
@@ -34,184 +608,4194 @@ static inline int parse_int(const char *s) {
 
 #ifdef FIREF_IMPL
 
-Obj load_obj(const char *path) {
-    FILE *file = fopen(path, "r");
-    if (!file) {
-        fprintf(stderr, "Failed to open %s\n", path);
-        exit(1);
+#include <sys/stat.h>
+#include <math.h>
+#include <float.h>
+
+// Allocation hooks: define all three before including firef.h with
+// FIREF_IMPL to route every heap allocation of the library elsewhere.
+#if !defined(FIREF_MALLOC) && !defined(FIREF_REALLOC) && !defined(FIREF_FREE)
+#define FIREF_MALLOC(size) malloc(size)
+#define FIREF_REALLOC(ptr, size) realloc(ptr, size)
+#define FIREF_FREE(ptr) free(ptr)
+#elif !defined(FIREF_MALLOC) || !defined(FIREF_REALLOC) || !defined(FIREF_FREE)
+#error "FIREF_MALLOC, FIREF_REALLOC and FIREF_FREE must be defined together"
+#endif
+
+static void *firef_calloc(size_t count, size_t size) {
+    if (size && count > SIZE_MAX / size) return NULL;
+    void *ptr = FIREF_MALLOC(count * size);
+    if (ptr) memset(ptr, 0, count * size);
+    return ptr;
+}
+
+#if !defined(FIREF_NO_MMAP) && (defined(__unix__) || defined(__APPLE__))
+#define FIREF_HAS_MMAP 1
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#if !defined(FIREF_NO_THREADS)
+#if defined(_WIN32)
+#define FIREF_HAS_THREADS 1
+#include <windows.h>
+#elif defined(__unix__) || defined(__APPLE__)
+#define FIREF_HAS_THREADS 1
+#include <pthread.h>
+#include <sched.h>
+#endif
+#endif
+
+// Lines are split with SSE2 everywhere it is part of the target and with
+// AVX2 where the CPU has it; FIREF_NO_SIMD keeps the scalar code.
+#if !defined(FIREF_NO_SIMD) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define FIREF_HAS_SSE2 1
+#include <emmintrin.h>
+#if defined(__GNUC__) || defined(__clang__) || defined(_MSC_VER)
+#define FIREF_HAS_AVX2 1
+#include <immintrin.h>
+#endif
+#endif
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#if defined(__GNUC__) || defined(__clang__)
+#define FIREF_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define FIREF_TARGET_AVX2
+#endif
+
+#define FIREF_MAX_FACE_VERTICES 32
+// Chunks smaller than this are not worth a thread of their own.
+#ifndef FIREF_MIN_CHUNK_SIZE
+#define FIREF_MIN_CHUNK_SIZE (256 * 1024)
+#endif
+
+// Whole file contents, either mapped read-only or read into one heap buffer.
+typedef struct {
+    const char *data;
+    size_t size;
+    int mapped;
+} FirefFileView;
+
+#define FIREF_CACHE_EXTENSION ".firefbin"
+#define FIREF_CACHE_VERSION 8
+#define FIREF_CACHE_ALIGNMENT 64
+// Flags that change what a load produces and therefore key the sidecar.
+#define FIREF_CACHE_FLAG_MASK (~(FIREF_LOAD_NO_CACHE | FIREF_LOAD_WRITE_CACHE | FIREF_LOAD_EXACT_SIZE))
+
+// Binary sidecar header. The file is in native byte order and the arrays
+// follow at FIREF_CACHE_ALIGNMENT-aligned offsets, so the sidecar can be
+// mapped and used without any parsing.
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;
+    uint32_t flags;
+    uint32_t floats_per_vertex;
+    uint32_t index_size;
+    uint32_t layout;
+    uint64_t source_size;
+    int64_t source_mtime;
+    int64_t source_mtime_nsec;
+    uint64_t source_hash;
+    uint64_t vertex_count;
+    uint64_t index_count;
+    uint64_t vertex_offset;
+    uint64_t index_offset;
+    ObjBounds bounds;
+    float smoothing_angle;
+    uint32_t normal_weighting;
+} FirefCacheHeader;
+
+// One face corner as written in the file, 0-based. Negative OBJ indices
+// can only be resolved once the attribute counts of earlier chunks are
+// known, so they are stored relative to the start of their chunk and
+// flagged in relative. -1 without the flag means the index is absent.
+typedef struct {
+    int v, t, n;
+    unsigned char relative;
+} FirefCorner;
+
+#define FIREF_RELATIVE_V 1
+#define FIREF_RELATIVE_T 2
+#define FIREF_RELATIVE_N 4
+
+// Running bounds of a run of positions. The sphere grows one point at a
+// time (Ritter's update), so it needs no second pass over the data.
+typedef struct {
+    size_t count;
+    float min[3], max[3];
+    double sum[3];
+    double center[3];
+    double radius;
+} FirefBounds;
+
+// Progress and cancellation of an async load, updated by the chunk
+// parsers every FIREF_PROGRESS_BLOCK bytes. NULL for other loads.
+typedef struct {
+    uint64_t consumed;
+    uint64_t size;
+    uint64_t cancelled;
+} FirefLoadControl;
+
+#define FIREF_PROGRESS_BLOCK (64 * 1024)
+
+// A line-aligned slice of the input and everything parsed from it.
+typedef struct {
+    const char *begin, *end;
+    unsigned int attributes;
+    FirefLoadControl *control;
+    ObjArena *scratch;
+
+    float *positions, *uvs, *normals;
+    size_t pos_len, uv_len, norm_len;
+    size_t pos_cap, uv_cap, norm_cap;
+
+    FirefCorner *corners;
+    size_t corner_len, corner_cap;
+    unsigned char *face_sizes;
+    size_t face_len, face_cap;
+    size_t tri_count;
+    FirefBounds bounds;
+
+    // Filled by the prefix sum over all chunks before assembly.
+    size_t pos_base, uv_base, norm_base;
+    size_t corner_base, tri_base;
+
+    int status;
+} FirefChunk;
+
+typedef struct {
+    FirefChunk *chunks;
+    int chunk_count;
+
+    const float *positions, *uvs, *normals;
+    size_t pos_count, uv_count, norm_count;
+
+    ObjArena *scratch;
+    // FIREF_LOAD_EXACT_SIZE: the chunk arrays are slices of one buffer
+    // per stream, owned by the first chunk.
+    int exact;
+    Obj mesh;
+} FirefAssembly;
+
+static int firef_read_file(const char *path, FirefFileView *view) {
+    FILE *file = fopen(path, "rb");
+    if (!file) return -1;
+
+    size_t cap = 1 << 16, size = 0;
+    char *buffer = (char*)FIREF_MALLOC(cap);
+    if (!buffer) { fclose(file); return -1; }
+
+    for (;;) {
+        if (size == cap) {
+            char *tmp = (char*)FIREF_REALLOC(buffer, cap * 2);
+            if (!tmp) { FIREF_FREE(buffer); fclose(file); return -1; }
+            buffer = tmp;
+            cap *= 2;
+        }
+        size_t n = fread(buffer + size, 1, cap - size, file);
+        size += n;
+        if (n == 0) break;
     }
 
-    float *positions = NULL, *uvs = NULL, *normals = NULL;
-    size_t pos_len = 0, uv_len = 0, norm_len = 0;
-    float *vertices = NULL;
-    size_t vert_len = 0, vert_cap = 0;
-    unsigned int *indices = NULL;
-    size_t idx_len = 0, idx_cap = 0;
-
-    char line[512];
-    unsigned int vertex_counter = 0;
-
-    while (fgets(line, sizeof(line), file)) {
-        char* p = line;  
-        char* end_ptr = NULL;
-        float x = 0, y = 0, z = 0; 
-
-        while (isspace(*p) && *p != '\n' && *p != '\0') p++;
-
-        if (strncmp(p, "v", 1) == 0 && isspace(p[1])) { 
-            p += 1; 
-            while (isspace(*p)) p++; 
-            x = strtof(p, &end_ptr); p = end_ptr;
-            while (isspace(*p)) p++; 
-            y = strtof(p, &end_ptr); p = end_ptr;
-            while (isspace(*p)) p++;
-            z = strtof(p, &end_ptr); 
-
-            float *tmp = (float*)realloc(positions, (pos_len + 3) * sizeof(float));
-            if (!tmp) exit(1);
-            positions = tmp;
-            positions[pos_len++] = x;
-            positions[pos_len++] = y;
-            positions[pos_len++] = z;
-        } else if (strncmp(p, "vt", 2) == 0 && isspace(p[2])) { 
-            p += 2; 
-            while (isspace(*p)) p++;
-            x = strtof(p, &end_ptr); p = end_ptr;
-            while (isspace(*p)) p++;
-            y = strtof(p, &end_ptr);
-
-            float *tmp = (float*)realloc(uvs, (uv_len + 2) * sizeof(float));
-            if (!tmp) exit(1);
-            uvs = tmp;
-            uvs[uv_len++] = x;
-            uvs[uv_len++] = y;
-        } else if (strncmp(p, "vn", 2) == 0 && isspace(p[2])) { 
-            p += 2; 
-            while (isspace(*p)) p++;
-            x = strtof(p, &end_ptr); p = end_ptr;
-            while (isspace(*p)) p++;
-            y = strtof(p, &end_ptr); p = end_ptr;
-            while (isspace(*p)) p++;
-            z = strtof(p, &end_ptr);
-
-            float *tmp = (float*)realloc(normals, (norm_len + 3) * sizeof(float));
-            if (!tmp) exit(1);
-            normals = tmp;
-            normals[norm_len++] = x;
-            normals[norm_len++] = y;
-            normals[norm_len++] = z;
-        } else if (strncmp(p, "f", 1) == 0 && isspace(p[1])) {
-            char *face_data_start = p + 1; 
-            while(isspace(*face_data_start)) face_data_start++;
-
-            char *token = strtok(face_data_start, " \n"); 
-            unsigned int face[32];
-            int count = 0;
+    int failed = ferror(file);
+    fclose(file);
+    if (failed) { FIREF_FREE(buffer); return -1; }
 
-            while (token && count < 32) {
-                int current_vi = -1;
-                int current_ti = -1;
-                int current_ni = -1;
+    view->data = buffer;
+    view->size = size;
+    view->mapped = 0;
+    return 0;
+}
 
-                char* p_token = token;
-                char* end_ptr_face; 
+static int firef_map_file(const char *path, FirefFileView *view) {
+#ifdef FIREF_HAS_MMAP
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return -1;
 
-                current_vi = strtol(p_token, &end_ptr_face, 10);
-                if (p_token == end_ptr_face) { 
-                    fprintf(stderr, "Error parsing vertex index in face line: %s\n", token);
-                    exit(1);
-                }
-                p_token = end_ptr_face; 
+    struct stat st;
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+        void *addr = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (addr != MAP_FAILED) {
+#ifdef MADV_SEQUENTIAL
+            madvise(addr, (size_t)st.st_size, MADV_SEQUENTIAL);
+#endif
+            close(fd);
+            view->data = (const char*)addr;
+            view->size = (size_t)st.st_size;
+            view->mapped = 1;
+            return 0;
+        }
+    }
+    close(fd);
+#endif
+    return firef_read_file(path, view);
+}
 
-                
-                if (*p_token == '/') {
-                    p_token++; 
-                    
-                    if (*p_token != '/') { 
-                        current_ti = strtol(p_token, &end_ptr_face, 10);
-                        p_token = end_ptr_face; 
-                    }
-                    
-                    
-                    if (*p_token == '/') { 
-                        p_token++; 
-                        current_ni = strtol(p_token, &end_ptr_face, 10);
-                    }
-                }
-                
-                if (current_vi > 0) current_vi--; 
-                if (current_ti > 0) current_ti--; 
-                if (current_ni > 0) current_ni--; 
+static void firef_unmap_file(FirefFileView *view) {
+#ifdef FIREF_HAS_MMAP
+    if (view->mapped) {
+        munmap((void*)view->data, view->size);
+        return;
+    }
+#endif
+    FIREF_FREE((void*)view->data);
+}
+
+// Runs fn(ctx, 0) .. fn(ctx, count - 1), one call per thread. The calling
+// thread takes index 0; if threads cannot be created the remaining calls
+// run on the calling thread as well.
+#ifdef FIREF_HAS_THREADS
+typedef struct {
+    void (*fn)(void *ctx, int index);
+    void *ctx;
+    int index;
+} FirefThreadTask;
 
-                float vx = positions[current_vi * 3 + 0];
-                float vy = positions[current_vi * 3 + 1];
-                float vz = positions[current_vi * 3 + 2];
+#if defined(_WIN32)
+static DWORD WINAPI firef_thread_main(LPVOID arg) {
+    FirefThreadTask *task = (FirefThreadTask*)arg;
+    task->fn(task->ctx, task->index);
+    return 0;
+}
+#else
+static void *firef_thread_main(void *arg) {
+    FirefThreadTask *task = (FirefThreadTask*)arg;
+    task->fn(task->ctx, task->index);
+    return NULL;
+}
+#endif
+#endif
 
-                float tx = (current_ti >= 0 && (size_t)current_ti * 2 + 1 < uv_len) ? uvs[current_ti * 2 + 0] : 0.0f;
-                float ty = (current_ti >= 0 && (size_t)current_ti * 2 + 1 < uv_len) ? uvs[current_ti * 2 + 1] : 0.0f;
+// Counters shared between an async load and the threads watching it.
+#if defined(FIREF_HAS_THREADS) && defined(_WIN32)
+static inline uint64_t firef_atomic_load(uint64_t *p) { return (uint64_t)InterlockedCompareExchange64((volatile LONG64*)p, 0, 0); }
+static inline void firef_atomic_store(uint64_t *p, uint64_t value) { InterlockedExchange64((volatile LONG64*)p, (LONG64)value); }
+static inline void firef_atomic_add(uint64_t *p, uint64_t value) { InterlockedExchangeAdd64((volatile LONG64*)p, (LONG64)value); }
+static inline uint64_t firef_atomic_exchange(uint64_t *p, uint64_t value) { return (uint64_t)InterlockedExchange64((volatile LONG64*)p, (LONG64)value); }
+#elif defined(FIREF_HAS_THREADS)
+static inline uint64_t firef_atomic_load(uint64_t *p) { return __atomic_load_n(p, __ATOMIC_ACQUIRE); }
+static inline void firef_atomic_store(uint64_t *p, uint64_t value) { __atomic_store_n(p, value, __ATOMIC_RELEASE); }
+static inline void firef_atomic_add(uint64_t *p, uint64_t value) { __atomic_fetch_add(p, value, __ATOMIC_RELAXED); }
+static inline uint64_t firef_atomic_exchange(uint64_t *p, uint64_t value) { return __atomic_exchange_n(p, value, __ATOMIC_ACQUIRE); }
+#else
+static inline uint64_t firef_atomic_load(uint64_t *p) { return *p; }
+static inline void firef_atomic_store(uint64_t *p, uint64_t value) { *p = value; }
+static inline void firef_atomic_add(uint64_t *p, uint64_t value) { *p += value; }
+static inline uint64_t firef_atomic_exchange(uint64_t *p, uint64_t value) { uint64_t old = *p; *p = value; return old; }
+#endif
 
-                
-                float nx = (current_ni >= 0 && (size_t)current_ni * 3 + 2 < norm_len) ? normals[current_ni * 3 + 0] : 0.0f;
-                float ny = (current_ni >= 0 && (size_t)current_ni * 3 + 2 < norm_len) ? normals[current_ni * 3 + 1] : 0.0f; 
-                float nz = (current_ni >= 0 && (size_t)current_ni * 3 + 2 < norm_len) ? normals[current_ni * 3 + 2] : 0.0f; 
+// Every arena allocation is preceded by its size, so that realloc can copy
+// it; sizes are rounded up to keep 16-byte alignment.
+#define FIREF_ARENA_HEADER 16
+#define FIREF_ARENA_MIN_BLOCK (64 * 1024)
 
-                
-                if (vert_len + 8 > vert_cap) {
-                    size_t new_cap = vert_cap == 0 ? 64 : vert_cap * 2;
-                    float *tmp = (float*)realloc(vertices, new_cap * sizeof(float));
-                    if (!tmp) exit(1);
-                    vertices = tmp;
-                    vert_cap = new_cap;
-                }
+typedef struct FirefArenaBlock {
+    struct FirefArenaBlock *next;
+    size_t size;
+} FirefArenaBlock;
+
+static inline size_t firef_arena_round(size_t size) {
+    return FIREF_ARENA_HEADER + ((size + 15) & ~(size_t)15);
+}
 
-                vertices[vert_len++] = vx;
-                vertices[vert_len++] = vy;
-                vertices[vert_len++] = vz;
-                vertices[vert_len++] = tx;
-                vertices[vert_len++] = ty;
-                vertices[vert_len++] = nx;
-                vertices[vert_len++] = ny;
-                vertices[vert_len++] = nz;
+#define FIREF_ARENA_MAX_SPINS 64
 
-                face[count++] = vertex_counter++;
+// Tells the CPU it is in a spin loop, and gives up the time slice when
+// spinning did not help.
+static inline void firef_cpu_relax(void) {
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+    _mm_pause();
+#elif (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+    __builtin_ia32_pause();
+#elif (defined(__GNUC__) || defined(__clang__)) && (defined(__aarch64__) || defined(__arm__))
+    __asm__ __volatile__("yield");
+#endif
+}
+
+static inline void firef_yield(void) {
+#if defined(FIREF_HAS_THREADS) && defined(_WIN32)
+    SwitchToThread();
+#elif defined(FIREF_HAS_THREADS)
+    sched_yield();
+#endif
+}
 
-                
-                token = strtok(NULL, " \n");
+// Batch workers all allocate from a shared output arena, so waiters spin
+// on a plain load with a doubling number of pauses and then yield, rather
+// than hammering the lock with exchanges.
+static inline void firef_arena_lock(ObjArena *arena) {
+    unsigned int spins = 1;
+    while (firef_atomic_exchange(&arena->lock, 1)) {
+        do {
+            if (spins <= FIREF_ARENA_MAX_SPINS) {
+                for (unsigned int i = 0; i < spins; i++) firef_cpu_relax();
+                spins *= 2;
+            } else {
+                firef_yield();
             }
+        } while (firef_atomic_load(&arena->lock));
+    }
+}
+
+static inline void firef_arena_unlock(ObjArena *arena) {
+    firef_atomic_store(&arena->lock, 0);
+}
+
+// Takes size bytes from the current region, moving on to the spare block
+// or a new, twice as large one when it is full. Needs the lock.
+static void *firef_arena_carve(ObjArena *arena, size_t size) {
+    size_t need = firef_arena_round(size);
+    if (need < size) return NULL;
+    if (!arena->cursor || (size_t)(arena->limit - arena->cursor) < need) {
+        FirefArenaBlock *block = (FirefArenaBlock*)arena->spare;
+        if (block && block->size >= need) {
+            arena->spare = NULL;
+        } else {
+            FirefArenaBlock *newest = (FirefArenaBlock*)arena->blocks;
+            size_t block_size = newest ? newest->size * 2 : FIREF_ARENA_MIN_BLOCK;
+            if (block_size < need) block_size = need;
+            block = (FirefArenaBlock*)FIREF_MALLOC(FIREF_ARENA_HEADER + block_size);
+            if (!block) return NULL;
+            block->size = block_size;
+            block->next = newest;
+            arena->blocks = block;
+        }
+        arena->cursor = (unsigned char*)block + FIREF_ARENA_HEADER;
+        arena->limit = arena->cursor + block->size;
+    }
+    unsigned char *header = arena->cursor;
+    memcpy(header, &size, sizeof(size));
+    arena->cursor += need;
+    arena->used += need;
+    if (arena->used > arena->peak) arena->peak = arena->used;
+    return header + FIREF_ARENA_HEADER;
+}
+
+static void *firef_arena_alloc(ObjArena *arena, size_t size) {
+    firef_arena_lock(arena);
+    void *ptr = firef_arena_carve(arena, size);
+    firef_arena_unlock(arena);
+    return ptr;
+}
+
+// Grows or shrinks the newest allocation in place; anything else moves.
+static void *firef_arena_realloc(ObjArena *arena, void *ptr, size_t size) {
+    if (!ptr) return firef_arena_alloc(arena, size);
+    unsigned char *header = (unsigned char*)ptr - FIREF_ARENA_HEADER;
+    size_t old;
+    memcpy(&old, header, sizeof(old));
+    size_t old_need = firef_arena_round(old), need = firef_arena_round(size);
+
+    firef_arena_lock(arena);
+    if (header + old_need == arena->cursor && need <= old_need + (size_t)(arena->limit - arena->cursor)) {
+        arena->cursor = header + need;
+        arena->used = arena->used - old_need + need;
+        if (arena->used > arena->peak) arena->peak = arena->used;
+        memcpy(header, &size, sizeof(size));
+        firef_arena_unlock(arena);
+        return ptr;
+    }
+    if (size <= old) {
+        firef_arena_unlock(arena);
+        return ptr;
+    }
+    void *moved = firef_arena_carve(arena, size);
+    firef_arena_unlock(arena);
+    if (moved) memcpy(moved, ptr, old);
+    return moved;
+}
+
+// Heap (through the FIREF_* hooks) when arena is NULL.
+static inline void *firef_alloc(ObjArena *arena, size_t size) {
+    return arena ? firef_arena_alloc(arena, size) : FIREF_MALLOC(size);
+}
+
+static inline void *firef_realloc(ObjArena *arena, void *ptr, size_t size) {
+    return arena ? firef_arena_realloc(arena, ptr, size) : FIREF_REALLOC(ptr, size);
+}
+
+static inline void firef_free(ObjArena *arena, void *ptr) {
+    if (!arena) FIREF_FREE(ptr);
+}
 
-            for (int i = 1; i < count - 1; ++i) {
-                if (idx_len + 3 > idx_cap) {
-                    size_t new_cap = idx_cap == 0 ? 64 : idx_cap * 2;
-                    unsigned int *tmp = (unsigned int*)realloc(indices, new_cap * sizeof(unsigned int));
-                    if (!tmp) exit(1);
-                    indices = tmp;
-                    idx_cap = new_cap;
+// The thread bookkeeping comes from scratch, or the heap when it is NULL.
+static void firef_parallel_for(ObjArena *scratch, int count, void (*fn)(void *ctx, int index), void *ctx) {
+#ifdef FIREF_HAS_THREADS
+    if (count > 1) {
+        FirefThreadTask *tasks = (FirefThreadTask*)firef_alloc(scratch, (size_t)count * sizeof(FirefThreadTask));
+#if defined(_WIN32)
+        HANDLE *threads = (HANDLE*)firef_alloc(scratch, (size_t)count * sizeof(HANDLE));
+#else
+        pthread_t *threads = (pthread_t*)firef_alloc(scratch, (size_t)count * sizeof(pthread_t));
+#endif
+        char *started = (char*)firef_alloc(scratch, (size_t)count);
+        if (tasks && threads && started) {
+            memset(started, 0, (size_t)count);
+            for (int i = 1; i < count; i++) {
+                tasks[i].fn = fn;
+                tasks[i].ctx = ctx;
+                tasks[i].index = i;
+#if defined(_WIN32)
+                threads[i] = CreateThread(NULL, 0, firef_thread_main, &tasks[i], 0, NULL);
+                started[i] = threads[i] != NULL;
+#else
+                started[i] = pthread_create(&threads[i], NULL, firef_thread_main, &tasks[i]) == 0;
+#endif
+            }
+            fn(ctx, 0);
+            for (int i = 1; i < count; i++) {
+                if (!started[i]) {
+                    fn(ctx, i);
+                    continue;
                 }
+#if defined(_WIN32)
+                WaitForSingleObject(threads[i], INFINITE);
+                CloseHandle(threads[i]);
+#else
+                pthread_join(threads[i], NULL);
+#endif
+            }
+            firef_free(scratch, tasks);
+            firef_free(scratch, threads);
+            firef_free(scratch, started);
+            return;
+        }
+        firef_free(scratch, tasks);
+        firef_free(scratch, threads);
+        firef_free(scratch, started);
+    }
+#else
+    (void)scratch;
+#endif
+    for (int i = 0; i < count; i++) fn(ctx, i);
+}
+
+void obj_arena_init(ObjArena *arena, void *buffer, size_t size) {
+    memset(arena, 0, sizeof(*arena));
+    arena->buffer = (unsigned char*)buffer;
+    arena->buffer_size = buffer ? size : 0;
+    obj_arena_reset(arena);
+}
+
+void obj_arena_reset(ObjArena *arena) {
+    FirefArenaBlock *newest = (FirefArenaBlock*)arena->blocks;
+    if (newest) {
+        FirefArenaBlock *block = newest->next;
+        while (block) {
+            FirefArenaBlock *next = block->next;
+            FIREF_FREE(block);
+            block = next;
+        }
+        newest->next = NULL;
+    }
+    arena->spare = newest;
+    arena->cursor = NULL;
+    arena->limit = NULL;
+    if (arena->buffer_size) {
+        uintptr_t start = ((uintptr_t)arena->buffer + 15) & ~(uintptr_t)15;
+        uintptr_t end = (uintptr_t)arena->buffer + arena->buffer_size;
+        if (start < end) {
+            arena->cursor = (unsigned char*)start;
+            arena->limit = (unsigned char*)end;
+        }
+    }
+    arena->used = 0;
+}
+
+void obj_arena_free(ObjArena *arena) {
+    obj_arena_reset(arena);
+    FIREF_FREE(arena->blocks);
+    arena->blocks = NULL;
+    arena->spare = NULL;
+}
+
+static inline int firef_is_space(char c) {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\v' || c == '\f';
+}
+
+static inline unsigned int firef_ctz64(uint64_t x) {
+#if defined(__GNUC__) || defined(__clang__)
+    return (unsigned int)__builtin_ctzll(x);
+#elif defined(_MSC_VER) && defined(_M_X64)
+    unsigned long index;
+    _BitScanForward64(&index, x);
+    return (unsigned int)index;
+#else
+    unsigned int index = 0;
+    while (!(x & 1)) {
+        x >>= 1;
+        index++;
+    }
+    return index;
+#endif
+}
+
+// Sets bit i of *space when byte i of the 64-byte block at p is
+// whitespace other than '\n', and bit i of *newline when it is '\n'.
+typedef void (*FirefScanBlock)(const char *p, uint64_t *space, uint64_t *newline);
 
-                indices[idx_len++] = face[0];
-                indices[idx_len++] = face[i];
-                indices[idx_len++] = face[i + 1];
+// Built everywhere: it is the fallback without SSE2 and the reference the
+// SIMD versions are checked against.
+static inline void firef_scan_block_scalar(const char *p, uint64_t *space, uint64_t *newline) {
+    uint64_t s = 0, n = 0;
+    for (int i = 0; i < 64; i++) {
+        s |= (uint64_t)firef_is_space(p[i]) << i;
+        n |= (uint64_t)(p[i] == '\n') << i;
+    }
+    *space = s;
+    *newline = n;
+}
+
+#if defined(FIREF_HAS_SSE2)
+// \t, \n, \v, \f and \r are 9..13, the bytes that land in 0..4 after
+// subtracting 9.
+static void firef_scan_block_sse2(const char *p, uint64_t *space, uint64_t *newline) {
+    const __m128i nine = _mm_set1_epi8(9);
+    const __m128i four = _mm_set1_epi8(4);
+    const __m128i blank = _mm_set1_epi8(' ');
+    const __m128i lf = _mm_set1_epi8('\n');
+    uint64_t s = 0, n = 0;
+    for (int i = 0; i < 4; i++) {
+        __m128i x = _mm_loadu_si128((const __m128i*)(const void*)(p + i * 16));
+        __m128i d = _mm_sub_epi8(x, nine);
+        __m128i control = _mm_cmpeq_epi8(_mm_min_epu8(d, four), d);
+        __m128i nl = _mm_cmpeq_epi8(x, lf);
+        __m128i sp = _mm_andnot_si128(nl, _mm_or_si128(control, _mm_cmpeq_epi8(x, blank)));
+        s |= (uint64_t)(uint32_t)_mm_movemask_epi8(sp) << (i * 16);
+        n |= (uint64_t)(uint32_t)_mm_movemask_epi8(nl) << (i * 16);
+    }
+    *space = s;
+    *newline = n;
+}
+#endif
+
+#if defined(FIREF_HAS_AVX2)
+FIREF_TARGET_AVX2 static void firef_scan_block_avx2(const char *p, uint64_t *space, uint64_t *newline) {
+    const __m256i nine = _mm256_set1_epi8(9);
+    const __m256i four = _mm256_set1_epi8(4);
+    const __m256i blank = _mm256_set1_epi8(' ');
+    const __m256i lf = _mm256_set1_epi8('\n');
+    uint64_t s = 0, n = 0;
+    for (int i = 0; i < 2; i++) {
+        __m256i x = _mm256_loadu_si256((const __m256i*)(const void*)(p + i * 32));
+        __m256i d = _mm256_sub_epi8(x, nine);
+        __m256i control = _mm256_cmpeq_epi8(_mm256_min_epu8(d, four), d);
+        __m256i nl = _mm256_cmpeq_epi8(x, lf);
+        __m256i sp = _mm256_andnot_si256(nl, _mm256_or_si256(control, _mm256_cmpeq_epi8(x, blank)));
+        s |= (uint64_t)(uint32_t)_mm256_movemask_epi8(sp) << (i * 32);
+        n |= (uint64_t)(uint32_t)_mm256_movemask_epi8(nl) << (i * 32);
+    }
+    *space = s;
+    *newline = n;
+}
+
+static int firef_cpu_has_avx2(void) {
+#if defined(_MSC_VER) && !defined(__clang__)
+    static int cached = -1;
+    if (cached < 0) {
+        int info[4];
+        int found = 0;
+        __cpuid(info, 0);
+        if (info[0] >= 7) {
+            __cpuid(info, 1);
+            // AVX and OSXSAVE, and the OS saves the ymm registers.
+            if ((info[2] & (1 << 27)) && (info[2] & (1 << 28)) && (_xgetbv(0) & 6) == 6) {
+                __cpuidex(info, 7, 0);
+                found = (info[1] >> 5) & 1;
             }
-        }    
+        }
+        cached = found;
     }
+    return cached;
+#else
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2") != 0;
+#endif
+}
+#endif
 
-    fclose(file);
-    free(positions);
-    free(uvs);
-    free(normals);
-
-    Obj obj = {
-        .vertices = vertices,
-        .vertex_count = vert_len,
-        .indices = indices,
-        .index_count = idx_len
-    };
-    return obj;
+static FirefScanBlock firef_select_scan_block(void) {
+#if defined(FIREF_HAS_AVX2)
+    if (firef_cpu_has_avx2()) return firef_scan_block_avx2;
+#endif
+#if defined(FIREF_HAS_SSE2)
+    return firef_scan_block_sse2;
+#else
+    return firef_scan_block_scalar;
+#endif
 }
 
-void free_obj(Obj *obj) {
-    free(obj->vertices);
-    free(obj->indices);
+typedef struct {
+    const char *begin, *end;
+} FirefToken;
+
+// A line split at whitespace. Only the keyword and as many tokens as the
+// largest face has corners are kept; the rest are skipped.
+#define FIREF_MAX_LINE_TOKENS (FIREF_MAX_FACE_VERTICES + 1)
+
+typedef struct {
+    FirefToken tokens[FIREF_MAX_LINE_TOKENS];
+    int token_count;
+    const char *end;
+} FirefLine;
+
+// Splits [base, end) into lines and tokens from the masks of one 64-byte
+// block at a time; live holds the bits of the block not consumed yet that
+// start a token or a line break. The last partial block is copied into
+// tail and padded with newlines, so nothing is read past end and the last
+// line always ends.
+typedef struct {
+    const char *base, *end;
+    uint64_t space, newline, live;
+    int last;
+    FirefScanBlock scan;
+    char tail[64];
+} FirefTokenizer;
+
+static void firef_tokenizer_load(FirefTokenizer *t) {
+    size_t left = (size_t)(t->end - t->base);
+    if (left >= sizeof(t->tail)) {
+        t->scan(t->base, &t->space, &t->newline);
+        t->live = ~t->space;
+        t->last = 0;
+        return;
+    }
+    memset(t->tail, '\n', sizeof(t->tail));
+    if (left) memcpy(t->tail, t->base, left);
+    t->scan(t->tail, &t->space, &t->newline);
+    // Up to and including the first padding newline.
+    t->live = ~t->space & (((uint64_t)2 << left) - 1);
+    t->last = 1;
+}
+
+static void firef_tokenizer_init(FirefTokenizer *t, const char *begin, const char *end) {
+    t->base = begin;
+    t->end = end;
+    t->scan = firef_select_scan_block();
+    firef_tokenizer_load(t);
+}
+
+static inline void firef_tokenizer_advance(FirefTokenizer *t) {
+    t->base += 64;
+    firef_tokenizer_load(t);
+}
+
+// Splits the next line into tokens; line->end is its '\n' or the end of
+// the input. Returns 0 once the input is used up. The block state is kept
+// in locals so the token stores cannot alias it.
+static inline int firef_next_line(FirefTokenizer *t, FirefLine *line) {
+    const char *base = t->base;
+    uint64_t space = t->space, newline = t->newline, live = t->live;
+    int count = 0;
+
+    for (;;) {
+        if (!live) {
+            if (t->last) return 0;
+            firef_tokenizer_advance(t);
+            base = t->base;
+            space = t->space;
+            newline = t->newline;
+            live = t->live;
+            continue;
+        }
+        unsigned int i = firef_ctz64(live);
+        if ((newline >> i) & 1) {
+            line->end = base + i;
+            line->token_count = count;
+            t->live = live & (live - 1);
+            return 1;
+        }
+
+        const char *begin = base + i;
+        uint64_t stop = (space | newline) & (~(uint64_t)0 << i);
+        while (!stop) {
+            firef_tokenizer_advance(t);
+            base = t->base;
+            space = t->space;
+            newline = t->newline;
+            live = t->live;
+            stop = space | newline;
+        }
+        unsigned int j = firef_ctz64(stop);
+        live &= ~(uint64_t)0 << j;
+        if (count < FIREF_MAX_LINE_TOKENS) {
+            line->tokens[count].begin = begin;
+            line->tokens[count].end = base + j;
+            count++;
+        }
+    }
+}
+
+// Number i of a line, 0 when the line has fewer tokens. Since the token
+// end is known, plain decimals of up to 19 digits ("-38.3122") are read in
+// one pass with the fast path of parse_float_range, which gets the rest.
+static inline float firef_line_float(const FirefLine *line, int i) {
+    float value = 0.0f;
+    if (i >= line->token_count) return value;
+
+    const char *p = line->tokens[i].begin;
+    const char *end = line->tokens[i].end;
+    int negative = *p == '-';
+    if (*p == '-' || *p == '+') p++;
+    if (p != end && end - p <= 20) {
+        const char *dot = NULL;
+        unsigned long long mantissa = 0;
+        int digits = 0;
+        for (; p != end; p++) {
+            if (FIREF_IS_DIGIT(*p)) {
+                mantissa = mantissa * 10 + (unsigned)(*p - '0');
+                digits++;
+            } else if (*p == '.' && !dot) {
+                dot = p;
+            } else {
+                break;
+            }
+        }
+        if (p == end && digits && digits <= 19 && mantissa <= (1ULL << 53)) {
+            double scaled = (double)mantissa;
+            if (dot) scaled /= firef_pow10[end - dot - 1];
+            unsigned long long bits;
+            memcpy(&bits, &scaled, sizeof(bits));
+            if ((bits & 0x1FFFFFFFULL) != 0x10000000ULL) return negative ? -(float)scaled : (float)scaled;
+        }
+    }
+    parse_float_range(line->tokens[i].begin, line->tokens[i].end, &value);
+    return value;
+}
+
+// Grows *array geometrically so that it can hold at least needed elements.
+static int firef_reserve(ObjArena *arena, void **array, size_t *cap, size_t needed, size_t elem_size) {
+    if (needed <= *cap) return 0;
+    size_t new_cap = *cap == 0 ? 64 : *cap;
+    while (new_cap < needed) new_cap *= 2;
+    void *tmp = firef_realloc(arena, *array, new_cap * elem_size);
+    if (!tmp) return -1;
+    *array = tmp;
+    *cap = new_cap;
+    return 0;
+}
+
+static inline void firef_bounds_add(FirefBounds *b, const float p[3]) {
+    if (b->count++ == 0) {
+        for (int k = 0; k < 3; k++) {
+            b->min[k] = b->max[k] = p[k];
+            b->sum[k] = b->center[k] = p[k];
+        }
+        b->radius = 0.0;
+        return;
+    }
+    double d[3], dist2 = 0.0;
+    for (int k = 0; k < 3; k++) {
+        if (p[k] < b->min[k]) b->min[k] = p[k];
+        if (p[k] > b->max[k]) b->max[k] = p[k];
+        b->sum[k] += p[k];
+        d[k] = p[k] - b->center[k];
+        dist2 += d[k] * d[k];
+    }
+    if (dist2 > b->radius * b->radius) {
+        double dist = sqrt(dist2);
+        double radius = (b->radius + dist) * 0.5;
+        for (int k = 0; k < 3; k++) b->center[k] += d[k] * ((radius - b->radius) / dist);
+        b->radius = radius;
+    }
+}
+
+// Folds the bounds of another run into b.
+static void firef_bounds_merge(FirefBounds *b, const FirefBounds *other) {
+    if (other->count == 0) return;
+    if (b->count == 0) {
+        *b = *other;
+        return;
+    }
+    double d[3], dist2 = 0.0;
+    for (int k = 0; k < 3; k++) {
+        if (other->min[k] < b->min[k]) b->min[k] = other->min[k];
+        if (other->max[k] > b->max[k]) b->max[k] = other->max[k];
+        b->sum[k] += other->sum[k];
+        d[k] = other->center[k] - b->center[k];
+        dist2 += d[k] * d[k];
+    }
+    b->count += other->count;
+    double dist = sqrt(dist2);
+    if (dist + other->radius <= b->radius) return;
+    if (dist + b->radius <= other->radius) {
+        memcpy(b->center, other->center, sizeof(b->center));
+        b->radius = other->radius;
+        return;
+    }
+    double radius = (dist + b->radius + other->radius) * 0.5;
+    for (int k = 0; k < 3; k++) b->center[k] += d[k] * ((radius - b->radius) / dist);
+    b->radius = radius;
+}
+
+// Picks the smaller of the grown sphere and the one around the box.
+static void firef_bounds_finish(const FirefBounds *b, ObjBounds *out) {
+    memset(out, 0, sizeof(*out));
+    if (b->count == 0) return;
+    double box_center[3], box_radius = 0.0;
+    for (int k = 0; k < 3; k++) {
+        out->min[k] = b->min[k];
+        out->max[k] = b->max[k];
+        out->centroid[k] = (float)(b->sum[k] / (double)b->count);
+        box_center[k] = ((double)b->min[k] + b->max[k]) * 0.5;
+        box_radius += ((double)b->max[k] - box_center[k]) * ((double)b->max[k] - box_center[k]);
+    }
+    box_radius = sqrt(box_radius);
+    const double *center = box_radius < b->radius ? box_center : b->center;
+    double radius = box_radius < b->radius ? box_radius : b->radius;
+
+    // Cover the rounding of the center and radius to float.
+    float slack = 0.0f;
+    for (int k = 0; k < 3; k++) {
+        out->center[k] = (float)center[k];
+        float extent = fabsf(out->center[k]) + (float)radius;
+        if (extent > slack) slack = extent;
+    }
+    out->radius = (float)radius + slack * 4.0f * FLT_EPSILON;
+}
+
+static inline int firef_push_floats(ObjArena *arena, float **array, size_t *len, size_t *cap, const float *values, size_t count) {
+    if (*len + count > *cap && firef_reserve(arena, (void**)array, cap, *len + count, sizeof(float)) != 0) return -1;
+    memcpy(*array + *len, values, count * sizeof(float));
+    *len += count;
+    return 0;
+}
+
+// Converts a 1-based or negative OBJ index into a FirefCorner slot.
+// count is the number of elements of that kind read so far in the chunk.
+static inline int firef_corner_index(long index, size_t count, unsigned char flag, unsigned char *relative) {
+    if (index > 0) return index <= INT_MAX ? (int)(index - 1) : INT_MAX;
+    if (index == 0) return -1;
+    long local = (long)count + index;
+    *relative |= flag;
+    return local >= INT_MIN ? (int)local : INT_MIN;
+}
+
+typedef enum {
+    FIREF_RECORD_NONE,
+    FIREF_RECORD_POSITION,
+    FIREF_RECORD_TEXCOORD,
+    FIREF_RECORD_NORMAL,
+    FIREF_RECORD_FACE,
+    FIREF_RECORD_GROUP
+} FirefRecord;
+
+// Classifies a line by its keyword. Like vt and vn, the one-letter
+// keywords must be followed by whitespace on the same line.
+static inline FirefRecord firef_classify_line(const FirefLine *line) {
+    if (line->token_count == 0) return FIREF_RECORD_NONE;
+    const FirefToken *keyword = &line->tokens[0];
+    const char *k = keyword->begin;
+
+    if (keyword->end - k == 1 && keyword->end < line->end) {
+        if (k[0] == 'v') return FIREF_RECORD_POSITION;
+        if (k[0] == 'f') return FIREF_RECORD_FACE;
+        if (k[0] == 'g') return FIREF_RECORD_GROUP;
+    } else if (keyword->end - k == 2 && k[0] == 'v') {
+        if (k[1] == 't') return FIREF_RECORD_TEXCOORD;
+        if (k[1] == 'n') return FIREF_RECORD_NORMAL;
+    }
+    return FIREF_RECORD_NONE;
+}
+
+// Parses one v/vt/vn token of a face line. The indices are stored as
+// written (1-based or negative, 0 when absent); vt/vn indices are only
+// parsed if their FIREF_LOAD_* bit is in attributes. Returns -1 for a
+// token without a vertex index.
+static inline int firef_parse_face_token(const FirefToken *token, unsigned int attributes, long index[3]) {
+    const char *token_end = token->end;
+
+    index[0] = index[1] = index[2] = 0;
+    const char *p = parse_int_range(token->begin, token_end, &index[0]);
+    if (p == token->begin) {
+        fprintf(stderr, "Error parsing vertex index in face line: %.*s\n", (int)(token_end - token->begin), token->begin);
+        return -1;
+    }
+
+    if (p < token_end && *p == '/' && (attributes & (FIREF_LOAD_UVS | FIREF_LOAD_NORMALS))) {
+        p++;
+        if (p < token_end && *p != '/') {
+            if (attributes & FIREF_LOAD_UVS) p = parse_int_range(p, token_end, &index[1]);
+            if (!(attributes & FIREF_LOAD_NORMALS)) return 0;
+            while (p < token_end && *p != '/') p++;
+        }
+        if (p < token_end && *p == '/' && (attributes & FIREF_LOAD_NORMALS)) {
+            p++;
+            parse_int_range(p, token_end, &index[2]);
+        }
+    }
+    return 0;
+}
+
+static int firef_parse_face(FirefChunk *c, const FirefLine *line) {
+    int count = 0;
+    long index[3];
+
+    for (int i = 1; i < line->token_count; i++) {
+        if (firef_parse_face_token(&line->tokens[i], c->attributes, index) != 0) return -1;
+
+        if (firef_reserve(c->scratch, (void**)&c->corners, &c->corner_cap, c->corner_len + 1, sizeof(FirefCorner)) != 0) return -1;
+        FirefCorner *corner = &c->corners[c->corner_len++];
+        corner->relative = 0;
+        corner->v = firef_corner_index(index[0], c->pos_len / 3, FIREF_RELATIVE_V, &corner->relative);
+        corner->t = firef_corner_index(index[1], c->uv_len / 2, FIREF_RELATIVE_T, &corner->relative);
+        corner->n = firef_corner_index(index[2], c->norm_len / 3, FIREF_RELATIVE_N, &corner->relative);
+        count++;
+    }
+
+    if (count == 0) return 0;
+    if (firef_reserve(c->scratch, (void**)&c->face_sizes, &c->face_cap, c->face_len + 1, 1) != 0) return -1;
+    c->face_sizes[c->face_len++] = (unsigned char)count;
+    if (count > 2) c->tri_count += (size_t)count - 2;
+    return 0;
+}
+
+static int firef_parse_line(FirefChunk *c, const FirefLine *line) {
+    float xyz[3];
+
+    switch (firef_classify_line(line)) {
+        case FIREF_RECORD_POSITION:
+            // Positions are still counted when skipped so that face
+            // indices can be validated and resolved.
+            if (!(c->attributes & FIREF_LOAD_POSITIONS)) {
+                c->pos_len += 3;
+                return 0;
+            }
+            xyz[0] = firef_line_float(line, 1);
+            xyz[1] = firef_line_float(line, 2);
+            xyz[2] = firef_line_float(line, 3);
+            firef_bounds_add(&c->bounds, xyz);
+            return firef_push_floats(c->scratch, &c->positions, &c->pos_len, &c->pos_cap, xyz, 3);
+        case FIREF_RECORD_TEXCOORD:
+            if (!(c->attributes & FIREF_LOAD_UVS)) return 0;
+            xyz[0] = firef_line_float(line, 1);
+            xyz[1] = firef_line_float(line, 2);
+            return firef_push_floats(c->scratch, &c->uvs, &c->uv_len, &c->uv_cap, xyz, 2);
+        case FIREF_RECORD_NORMAL:
+            if (!(c->attributes & FIREF_LOAD_NORMALS)) return 0;
+            xyz[0] = firef_line_float(line, 1);
+            xyz[1] = firef_line_float(line, 2);
+            xyz[2] = firef_line_float(line, 3);
+            return firef_push_floats(c->scratch, &c->normals, &c->norm_len, &c->norm_cap, xyz, 3);
+        case FIREF_RECORD_FACE:
+            return firef_parse_face(c, line);
+        default:
+            return 0;
+    }
+}
+
+// Lines are split by the block tokenizer and parsed in place with bounded
+// number parsers, so the input is never copied and needs no terminator.
+static void firef_parse_chunk(void *ctx, int index) {
+    FirefChunk *c = &((FirefAssembly*)ctx)->chunks[index];
+    const char *cur = c->begin;
+    const char *reported = cur;
+    FirefTokenizer tokenizer;
+    FirefLine line;
+
+    firef_tokenizer_init(&tokenizer, c->begin, c->end);
+    while (c->status == 0 && firef_next_line(&tokenizer, &line)) {
+        if (c->control && cur - reported >= FIREF_PROGRESS_BLOCK) {
+            firef_atomic_add(&c->control->consumed, (uint64_t)(cur - reported));
+            reported = cur;
+            if (firef_atomic_load(&c->control->cancelled)) {
+                c->status = -1;
+                break;
+            }
+        }
+        c->status = firef_parse_line(c, &line);
+        cur = line.end < c->end ? line.end + 1 : c->end;
+    }
+    if (c->control) firef_atomic_add(&c->control->consumed, (uint64_t)(cur - reported));
+}
+
+// Tokens after a face keyword, as many as firef_next_line keeps.
+static inline size_t firef_count_corners(const char *p, const char *end) {
+    size_t count = 0;
+    while (count < FIREF_MAX_FACE_VERTICES) {
+        while (p < end && firef_is_space(*p)) p++;
+        if (p == end) break;
+        count++;
+        while (p < end && !firef_is_space(*p)) p++;
+    }
+    return count;
+}
+
+// First pass of FIREF_LOAD_EXACT_SIZE: counts what firef_parse_line will
+// store for the chunk into its *_cap fields. Only the keyword at the start
+// of each line is looked at, with the rules of firef_classify_line; face
+// lines also have their tokens counted.
+static void firef_count_chunk(void *ctx, int index) {
+    FirefChunk *c = &((FirefAssembly*)ctx)->chunks[index];
+    const char *p = c->begin;
+    const char *end = c->end;
+
+    while (p < end) {
+        const char *line_end = (const char*)memchr(p, '\n', (size_t)(end - p));
+        if (!line_end) line_end = end;
+        while (p < line_end && firef_is_space(*p)) p++;
+        size_t length = (size_t)(line_end - p);
+        if (length >= 2 && firef_is_space(p[1])) {
+            if (p[0] == 'v') {
+                c->pos_cap += 3;
+            } else if (p[0] == 'f') {
+                size_t corners = firef_count_corners(p + 1, line_end);
+                if (corners) {
+                    c->corner_cap += corners;
+                    c->face_cap++;
+                }
+            }
+        } else if (length >= 2 && p[0] == 'v' && (length == 2 || firef_is_space(p[2]))) {
+            if (p[1] == 't') c->uv_cap += 2;
+            else if (p[1] == 'n') c->norm_cap += 3;
+        }
+        p = line_end < end ? line_end + 1 : end;
+    }
+    if (!(c->attributes & FIREF_LOAD_POSITIONS)) c->pos_cap = 0;
+    if (!(c->attributes & FIREF_LOAD_UVS)) c->uv_cap = 0;
+    if (!(c->attributes & FIREF_LOAD_NORMALS)) c->norm_cap = 0;
+}
+
+// Allocates one buffer per stream for the counted capacities of all
+// chunks and points every chunk at its slice, so parsing never grows them.
+static int firef_presize_chunks(FirefAssembly *a) {
+    size_t pos = 0, uv = 0, norm = 0, corners = 0, faces = 0;
+    for (int i = 0; i < a->chunk_count; i++) {
+        FirefChunk *c = &a->chunks[i];
+        pos += c->pos_cap;
+        uv += c->uv_cap;
+        norm += c->norm_cap;
+        corners += c->corner_cap;
+        faces += c->face_cap;
+    }
+
+    FirefChunk *first = &a->chunks[0];
+    if (pos) first->positions = (float*)firef_alloc(a->scratch, pos * sizeof(float));
+    if (uv) first->uvs = (float*)firef_alloc(a->scratch, uv * sizeof(float));
+    if (norm) first->normals = (float*)firef_alloc(a->scratch, norm * sizeof(float));
+    if (corners) first->corners = (FirefCorner*)firef_alloc(a->scratch, corners * sizeof(FirefCorner));
+    if (faces) first->face_sizes = (unsigned char*)firef_alloc(a->scratch, faces);
+    if ((pos && !first->positions) || (uv && !first->uvs) || (norm && !first->normals) ||
+        (corners && !first->corners) || (faces && !first->face_sizes)) {
+        return -1;
+    }
+
+    for (int i = 1; i < a->chunk_count; i++) {
+        FirefChunk *prev = &a->chunks[i - 1];
+        FirefChunk *c = &a->chunks[i];
+        c->positions = prev->positions ? prev->positions + prev->pos_cap : NULL;
+        c->uvs = prev->uvs ? prev->uvs + prev->uv_cap : NULL;
+        c->normals = prev->normals ? prev->normals + prev->norm_cap : NULL;
+        c->corners = prev->corners ? prev->corners + prev->corner_cap : NULL;
+        c->face_sizes = prev->face_sizes ? prev->face_sizes + prev->face_cap : NULL;
+    }
+    return 0;
+}
+
+typedef struct {
+    const ObjStreamCallbacks *callbacks;
+    size_t pos_count, uv_count, norm_count;
+} FirefStream;
+
+// 0-based index of a record among the count read so far, -1 when absent
+// or out of range.
+static inline long firef_stream_index(long index, size_t count) {
+    if (index > 0 && (size_t)index <= count) return index - 1;
+    if (index < 0 && (size_t)-index <= count) return (long)count + index;
+    return -1;
+}
+
+static int firef_stream_line(FirefStream *st, const FirefLine *line) {
+    const ObjStreamCallbacks *cb = st->callbacks;
+
+    switch (firef_classify_line(line)) {
+        case FIREF_RECORD_POSITION:
+            st->pos_count++;
+            if (!cb->position) return 0;
+            return cb->position(cb->user, firef_line_float(line, 1), firef_line_float(line, 2), firef_line_float(line, 3));
+        case FIREF_RECORD_TEXCOORD:
+            st->uv_count++;
+            if (!cb->texcoord) return 0;
+            return cb->texcoord(cb->user, firef_line_float(line, 1), firef_line_float(line, 2));
+        case FIREF_RECORD_NORMAL:
+            st->norm_count++;
+            if (!cb->normal) return 0;
+            return cb->normal(cb->user, firef_line_float(line, 1), firef_line_float(line, 2), firef_line_float(line, 3));
+        case FIREF_RECORD_FACE: {
+            if (!cb->face) return 0;
+            ObjFaceCorner corners[FIREF_MAX_FACE_VERTICES];
+            long index[3];
+            int count = 0;
+            for (int i = 1; i < line->token_count; i++) {
+                if (firef_parse_face_token(&line->tokens[i], FIREF_LOAD_ALL_ATTRIBUTES, index) != 0) return -1;
+                ObjFaceCorner *corner = &corners[count++];
+                corner->v = firef_stream_index(index[0], st->pos_count);
+                corner->t = firef_stream_index(index[1], st->uv_count);
+                corner->n = firef_stream_index(index[2], st->norm_count);
+                if (corner->v < 0) {
+                    fprintf(stderr, "Vertex index out of range in face (%zu positions)\n", st->pos_count);
+                    return -1;
+                }
+            }
+            return count ? cb->face(cb->user, corners, count) : 0;
+        }
+        case FIREF_RECORD_GROUP: {
+            if (!cb->group) return 0;
+            // The name runs to the end of the line, spaces included.
+            const char *end = line->end;
+            const char *p = line->token_count > 1 ? line->tokens[1].begin : end;
+            while (end > p && firef_is_space(end[-1])) end--;
+            return cb->group(cb->user, p, (size_t)(end - p));
+        }
+        default:
+            return 0;
+    }
+}
+
+int stream_obj_file(FILE *file, const ObjStreamCallbacks *callbacks, size_t buffer_size) {
+    size_t cap = buffer_size ? buffer_size : FIREF_STREAM_BUFFER_SIZE;
+    char *buffer = (char*)FIREF_MALLOC(cap);
+    if (!buffer) return -1;
+
+    FirefStream st;
+    memset(&st, 0, sizeof(st));
+    st.callbacks = callbacks;
+
+    size_t len = 0;
+    int status = 0;
+    for (;;) {
+        size_t n = fread(buffer + len, 1, cap - len, file);
+        len += n;
+        if (n == 0 && ferror(file)) {
+            status = -1;
+            break;
+        }
+
+        // Only complete lines are split until the file runs out.
+        const char *end = buffer + len;
+        const char *complete = end;
+        if (n != 0) {
+            while (complete > buffer && complete[-1] != '\n') complete--;
+        }
+        FirefTokenizer tokenizer;
+        FirefLine line;
+        firef_tokenizer_init(&tokenizer, buffer, complete);
+        while (status == 0 && firef_next_line(&tokenizer, &line)) status = firef_stream_line(&st, &line);
+        if (status != 0 || n == 0) break;
+
+        // Keep the partial last line and refill behind it.
+        len = (size_t)(end - complete);
+        memmove(buffer, complete, len);
+        if (len == cap) {
+            char *tmp = (char*)FIREF_REALLOC(buffer, cap * 2);
+            if (!tmp) {
+                status = -1;
+                break;
+            }
+            buffer = tmp;
+            cap *= 2;
+        }
+    }
+
+    FIREF_FREE(buffer);
+    return status;
+}
+
+int stream_obj(const char *path, const ObjStreamCallbacks *callbacks, size_t buffer_size) {
+    FILE *file = fopen(path, "rb");
+    if (!file) {
+        fprintf(stderr, "Failed to open %s\n", path);
+        return -1;
+    }
+    int status = stream_obj_file(file, callbacks, buffer_size);
+    fclose(file);
+    return status;
+}
+
+static void *firef_aligned_alloc(ObjArena *arena, size_t size) {
+    void *raw = firef_alloc(arena, size + FIREF_SOA_ALIGNMENT + sizeof(void*));
+    if (!raw) return NULL;
+    uintptr_t addr = ((uintptr_t)raw + sizeof(void*) + FIREF_SOA_ALIGNMENT - 1) & ~(uintptr_t)(FIREF_SOA_ALIGNMENT - 1);
+    ((void**)addr)[-1] = raw;
+    return (void*)addr;
+}
+
+static void firef_aligned_free(ObjArena *arena, void *ptr) {
+    if (ptr) firef_free(arena, ((void**)ptr)[-1]);
+}
+
+static inline size_t firef_align_size(size_t size) {
+    return (size + FIREF_SOA_ALIGNMENT - 1) & ~(size_t)(FIREF_SOA_ALIGNMENT - 1);
+}
+
+// Tangents are never parsed, only generated, so they come last.
+#define FIREF_ATTRIBUTE_COUNT 4
+static const unsigned int firef_attribute_bits[FIREF_ATTRIBUTE_COUNT] = { FIREF_LOAD_POSITIONS, FIREF_LOAD_UVS, FIREF_LOAD_NORMALS, FIREF_LOAD_TANGENTS };
+static const unsigned int firef_attribute_sizes[FIREF_ATTRIBUTE_COUNT] = { 3, 2, 3, 4 };
+
+static inline unsigned int firef_attribute_mask(unsigned int flags) {
+    unsigned int attributes = flags & FIREF_LOAD_ALL_ATTRIBUTES;
+    return (attributes ? attributes : FIREF_LOAD_ALL_ATTRIBUTES) | (flags & FIREF_LOAD_TANGENTS);
+}
+
+static inline unsigned int firef_attribute_stride(unsigned int attributes) {
+    unsigned int stride = 0;
+    for (int i = 0; i < FIREF_ATTRIBUTE_COUNT; i++) {
+        if (attributes & firef_attribute_bits[i]) stride += firef_attribute_sizes[i];
+    }
+    return stride;
+}
+
+static inline float **firef_soa_stream(Obj *obj, int attribute) {
+    return attribute == 0 ? &obj->positions : attribute == 1 ? &obj->uvs : attribute == 2 ? &obj->normals : &obj->tangents;
+}
+
+// Allocates storage for count vertices in obj->layout with obj->stride and
+// obj->attributes already set. SoA streams share one block that starts
+// with the first loaded attribute.
+static int firef_alloc_vertices(Obj *obj, size_t count) {
+    if (count == 0) count = 1;
+    if (obj->layout == OBJ_LAYOUT_SOA) {
+        size_t offsets[FIREF_ATTRIBUTE_COUNT], total = 0;
+        for (int i = 0; i < FIREF_ATTRIBUTE_COUNT; i++) {
+            offsets[i] = total;
+            if (obj->attributes & firef_attribute_bits[i]) total += firef_align_size(count * firef_attribute_sizes[i] * sizeof(float));
+        }
+        char *block = (char*)firef_aligned_alloc(obj->arena, total ? total : 1);
+        if (!block) return -1;
+        for (int i = 0; i < FIREF_ATTRIBUTE_COUNT; i++) {
+            *firef_soa_stream(obj, i) = (obj->attributes & firef_attribute_bits[i]) ? (float*)(block + offsets[i]) : NULL;
+        }
+        obj->vertices = NULL;
+        return 0;
+    }
+    obj->vertices = (float*)firef_alloc(obj->arena, count * (obj->stride ? obj->stride : 8) * sizeof(float));
+    return obj->vertices ? 0 : -1;
+}
+
+// Start of the block holding all SoA streams, for freeing it.
+static inline float *firef_soa_block(const Obj *obj) {
+    return obj->positions ? obj->positions : obj->uvs ? obj->uvs : obj->normals ? obj->normals : obj->tangents;
+}
+
+// Lists the float arrays that hold obj's vertices, in storage order.
+static int firef_vertex_streams(const Obj *obj, float **streams, size_t *lengths) {
+    if (obj->layout == OBJ_LAYOUT_SOA) {
+        size_t count = obj->stride ? obj->vertex_count / obj->stride : 0;
+        int stream_count = 0;
+        for (int i = 0; i < FIREF_ATTRIBUTE_COUNT; i++) {
+            if (!(obj->attributes & firef_attribute_bits[i])) continue;
+            streams[stream_count] = *firef_soa_stream((Obj*)obj, i);
+            lengths[stream_count++] = count * firef_attribute_sizes[i];
+        }
+        return stream_count;
+    }
+    streams[0] = obj->vertices;
+    lengths[0] = obj->vertex_count;
+    return 1;
+}
+
+// Index width that format gives a mesh with vertex_total vertices, or 0
+// if the mesh cannot be stored in that format.
+static inline unsigned int firef_index_size(ObjIndexFormat format, size_t vertex_total) {
+    int fits16 = vertex_total <= 65536;
+    if (format == OBJ_INDEX_16) return fits16 ? 2 : 0;
+    if (format == OBJ_INDEX_AUTO && fits16) return 2;
+    return 4;
+}
+
+static inline unsigned int firef_index_at(const Obj *obj, size_t i) {
+    return obj->index_size == 2 ? obj->indices16[i] : obj->indices[i];
+}
+
+static inline void firef_set_index(Obj *obj, size_t i, unsigned int value) {
+    if (obj->index_size == 2) {
+        obj->indices16[i] = (uint16_t)value;
+    } else {
+        obj->indices[i] = value;
+    }
+}
+
+// Narrows the 32-bit index buffer of obj to 16 bits in place; every index
+// must be below 65536.
+static void firef_narrow_indices(Obj *obj) {
+    uint16_t *narrow = (uint16_t*)obj->indices;
+    for (size_t i = 0; i < obj->index_count; i++) narrow[i] = (uint16_t)obj->indices[i];
+    void *tmp = firef_realloc(obj->arena, narrow, (obj->index_count ? obj->index_count : 1) * sizeof(uint16_t));
+    obj->indices16 = tmp ? (uint16_t*)tmp : narrow;
+    obj->indices = NULL;
+    obj->index_size = 2;
+}
+
+// Frees the vertex storage of obj and takes over the one in replacement.
+static void firef_replace_vertices(Obj *obj, const Obj *replacement) {
+    if (obj->layout == OBJ_LAYOUT_SOA) {
+        firef_aligned_free(obj->arena, firef_soa_block(obj));
+    } else {
+        firef_free(obj->arena, obj->vertices);
+    }
+    obj->vertices = replacement->vertices;
+    obj->positions = replacement->positions;
+    obj->uvs = replacement->uvs;
+    obj->normals = replacement->normals;
+    obj->tangents = replacement->tangents;
+}
+
+// Releases the unused tail after deduplication left fewer vertices.
+static void firef_shrink_vertices(Obj *obj, size_t count) {
+    if (obj->layout == OBJ_LAYOUT_SOA) {
+        Obj shrunk = *obj;
+        if (firef_alloc_vertices(&shrunk, count) != 0) return;
+        for (int i = 0; i < FIREF_ATTRIBUTE_COUNT; i++) {
+            if (!(obj->attributes & firef_attribute_bits[i])) continue;
+            memcpy(*firef_soa_stream(&shrunk, i), *firef_soa_stream(obj, i), count * firef_attribute_sizes[i] * sizeof(float));
+        }
+        firef_aligned_free(obj->arena, firef_soa_block(obj));
+        *obj = shrunk;
+        return;
+    }
+    float *tmp = (float*)firef_realloc(obj->arena, obj->vertices, (count ? count : 1) * obj->stride * sizeof(float));
+    if (tmp) obj->vertices = tmp;
+}
+
+static inline long firef_resolve_corner(int index, int relative, size_t base, size_t count) {
+    long resolved = relative ? (long)base + index : index;
+    return resolved >= 0 && (size_t)resolved < count ? resolved : -1;
+}
+
+static inline int firef_resolve_corner_triple(const FirefAssembly *a, const FirefChunk *c, const FirefCorner *corner, long triple[3]) {
+    triple[0] = firef_resolve_corner(corner->v, corner->relative & FIREF_RELATIVE_V, c->pos_base, a->pos_count);
+    triple[1] = firef_resolve_corner(corner->t, corner->relative & FIREF_RELATIVE_T, c->uv_base, a->uv_count);
+    triple[2] = firef_resolve_corner(corner->n, corner->relative & FIREF_RELATIVE_N, c->norm_base, a->norm_count);
+    if (triple[0] < 0) {
+        fprintf(stderr, "Vertex index out of range in face (%zu positions)\n", a->pos_count);
+        return -1;
+    }
+    return 0;
+}
+
+static inline void firef_write_vertex(FirefAssembly *a, const long triple[3], size_t id) {
+    Obj *mesh = &a->mesh;
+    unsigned int attributes = mesh->attributes;
+    long ti = triple[1], ni = triple[2];
+    float v[12];
+    float *out = v;
+
+    if (attributes & FIREF_LOAD_POSITIONS) {
+        const float *pos = a->positions + triple[0] * 3;
+        *out++ = pos[0];
+        *out++ = pos[1];
+        *out++ = pos[2];
+    }
+    if (attributes & FIREF_LOAD_UVS) {
+        *out++ = ti >= 0 ? a->uvs[ti * 2 + 0] : 0.0f;
+        *out++ = ti >= 0 ? a->uvs[ti * 2 + 1] : 0.0f;
+    }
+    if (attributes & FIREF_LOAD_NORMALS) {
+        *out++ = ni >= 0 ? a->normals[ni * 3 + 0] : 0.0f;
+        *out++ = ni >= 0 ? a->normals[ni * 3 + 1] : 0.0f;
+        *out++ = ni >= 0 ? a->normals[ni * 3 + 2] : 0.0f;
+    }
+    if (attributes & FIREF_LOAD_TANGENTS) {
+        for (int k = 0; k < 4; k++) *out++ = 0.0f;
+    }
+
+    if (mesh->layout == OBJ_LAYOUT_SOA) {
+        const float *in = v;
+        for (int i = 0; i < FIREF_ATTRIBUTE_COUNT; i++) {
+            if (!(attributes & firef_attribute_bits[i])) continue;
+            memcpy(*firef_soa_stream(mesh, i) + id * firef_attribute_sizes[i], in, firef_attribute_sizes[i] * sizeof(float));
+            in += firef_attribute_sizes[i];
+        }
+    } else {
+        memcpy(mesh->vertices + id * mesh->stride, v, mesh->stride * sizeof(float));
+    }
+}
+
+static inline unsigned int *firef_triangulate(unsigned int *out, const unsigned int *face, int count) {
+    for (int i = 1; i < count - 1; ++i) {
+        *out++ = face[0];
+        *out++ = face[i];
+        *out++ = face[i + 1];
+    }
+    return out;
+}
+
+static void firef_assemble_chunk(void *ctx, int index) {
+    FirefAssembly *a = (FirefAssembly*)ctx;
+    FirefChunk *c = &a->chunks[index];
+
+    const FirefCorner *corner = c->corners;
+    unsigned int *out = a->mesh.indices + c->tri_base * 3;
+    unsigned int next = (unsigned int)c->corner_base;
+    unsigned int face[FIREF_MAX_FACE_VERTICES];
+    long triple[3];
+
+    for (size_t f = 0; f < c->face_len; f++) {
+        int count = c->face_sizes[f];
+        for (int k = 0; k < count; k++, corner++) {
+            if (firef_resolve_corner_triple(a, c, corner, triple) != 0) {
+                c->status = -1;
+                return;
+            }
+            firef_write_vertex(a, triple, next);
+            face[k] = next++;
+        }
+        out = firef_triangulate(out, face, count);
+    }
+}
+
+static inline size_t firef_hash_triple(const long triple[3]) {
+    unsigned long long h = (unsigned long long)triple[0] * 0x9E3779B97F4A7C15ULL;
+    h ^= (unsigned long long)(triple[1] + 1) * 0xC2B2AE3D27D4EB4FULL;
+    h ^= (unsigned long long)(triple[2] + 1) * 0x165667B19E3779F9ULL;
+    h ^= h >> 29;
+    return (size_t)h;
+}
+
+// Serial assembly for FIREF_LOAD_DEDUPLICATE. Every resolved v/vt/vn
+// triple is looked up in an open-addressing (linear probing) table that
+// maps it to the output vertex created for its first occurrence; the
+// table stores vertex ids and the triples live in a parallel key array.
+// Returns the number of unique vertices, or (size_t)-1 on failure.
+static size_t firef_assemble_deduplicated(FirefAssembly *a, size_t corner_total) {
+    size_t table_size = 64;
+    while (table_size < corner_total * 2) table_size *= 2;
+
+    unsigned int *table = (unsigned int*)firef_alloc(a->scratch, table_size * sizeof(unsigned int));
+    long *keys = (long*)firef_alloc(a->scratch, (corner_total ? corner_total : 1) * 3 * sizeof(long));
+    if (!table || !keys) {
+        firef_free(a->scratch, table);
+        firef_free(a->scratch, keys);
+        return (size_t)-1;
+    }
+    memset(table, 0xFF, table_size * sizeof(unsigned int));
+
+    unsigned int *out = a->mesh.indices;
+    unsigned int unique = 0;
+    unsigned int face[FIREF_MAX_FACE_VERTICES];
+    long triple[3];
+    size_t result = 0;
+
+    for (int i = 0; i < a->chunk_count && result == 0; i++) {
+        const FirefChunk *c = &a->chunks[i];
+        const FirefCorner *corner = c->corners;
+
+        for (size_t f = 0; f < c->face_len && result == 0; f++) {
+            int count = c->face_sizes[f];
+            for (int k = 0; k < count; k++, corner++) {
+                if (firef_resolve_corner_triple(a, c, corner, triple) != 0) {
+                    result = (size_t)-1;
+                    break;
+                }
+
+                size_t slot = firef_hash_triple(triple) & (table_size - 1);
+                for (;;) {
+                    unsigned int id = table[slot];
+                    if (id == UINT_MAX) {
+                        id = unique++;
+                        table[slot] = id;
+                        memcpy(keys + (size_t)id * 3, triple, sizeof(triple));
+                        firef_write_vertex(a, triple, id);
+                        face[k] = id;
+                        break;
+                    }
+                    if (memcmp(keys + (size_t)id * 3, triple, sizeof(triple)) == 0) {
+                        face[k] = id;
+                        break;
+                    }
+                    slot = (slot + 1) & (table_size - 1);
+                }
+            }
+            if (result == 0) out = firef_triangulate(out, face, count);
+        }
+    }
+
+    firef_free(a->scratch, table);
+    firef_free(a->scratch, keys);
+    return result == 0 ? unique : result;
+}
+
+static void firef_free_chunk(FirefChunk *c) {
+    firef_free(c->scratch, c->positions);
+    firef_free(c->scratch, c->uvs);
+    firef_free(c->scratch, c->normals);
+    firef_free(c->scratch, c->corners);
+    firef_free(c->scratch, c->face_sizes);
+}
+
+static float **firef_chunk_attribute(FirefChunk *c, int attribute, size_t *len) {
+    switch (attribute) {
+        case 0: *len = c->pos_len; return &c->positions;
+        case 1: *len = c->uv_len; return &c->uvs;
+        default: *len = c->norm_len; return &c->normals;
+    }
+}
+
+// Concatenates one attribute stream (0 positions, 1 uvs, 2 normals) of
+// every chunk. A single chunk, or the first one when the chunks share
+// one exact-size buffer, hands over its array instead of copying it.
+static float *firef_merge_attribute(FirefAssembly *a, int attribute, size_t total) {
+    size_t len;
+    if (!(a->mesh.attributes & firef_attribute_bits[attribute])) return NULL;
+    if (a->chunk_count == 1 || a->exact) {
+        float **array = firef_chunk_attribute(&a->chunks[0], attribute, &len);
+        float *merged = *array;
+        *array = NULL;
+        return merged;
+    }
+
+    float *merged = (float*)firef_alloc(a->scratch, (total ? total : 1) * sizeof(float));
+    if (!merged) return NULL;
+    size_t at = 0;
+    for (int i = 0; i < a->chunk_count; i++) {
+        float **array = firef_chunk_attribute(&a->chunks[i], attribute, &len);
+        if (len) memcpy(merged + at, *array, len * sizeof(float));
+        at += len;
+    }
+    return merged;
+}
+
+// Defined with obj_generate_normals and obj_generate_tangents further
+// down; a load runs them with its scratch arena.
+static int firef_generate_normals(ObjArena *scratch, Obj *obj, float smoothing_angle, ObjNormalWeighting weighting, int threads);
+static int firef_generate_tangents(ObjArena *scratch, Obj *obj, int threads);
+
+// Splits data into line-aligned chunks, parses them (in parallel when
+// options->threads > 1), then does a prefix sum over the per-chunk counts
+// to resolve face indices and write the interleaved output in place.
+// control, when not NULL, tracks progress and can cancel the parse.
+static int firef_parse_obj(const char *data, size_t size, const ObjLoadOptions *options, FirefLoadControl *control, Obj *out) {
+    int threads = options && options->threads > 1 ? options->threads : 1;
+    size_t max_chunks = size / FIREF_MIN_CHUNK_SIZE + 1;
+    int chunk_count = (size_t)threads < max_chunks ? threads : (int)max_chunks;
+
+    FirefAssembly a;
+    memset(&a, 0, sizeof(a));
+    a.scratch = options ? options->scratch_arena : NULL;
+    // Scratch buffers are freed between output allocations, which an arena
+    // cannot take back, so a shared arena leaves the temporaries on the heap.
+    if (options && a.scratch == options->output_arena) a.scratch = NULL;
+    a.chunks = (FirefChunk*)firef_alloc(a.scratch, (size_t)chunk_count * sizeof(FirefChunk));
+    if (!a.chunks) return -1;
+    memset(a.chunks, 0, (size_t)chunk_count * sizeof(FirefChunk));
+    a.mesh.arena = options ? options->output_arena : NULL;
+    a.mesh.layout = options ? options->layout : OBJ_LAYOUT_AOS;
+    a.mesh.attributes = firef_attribute_mask(options ? options->flags : 0);
+    a.mesh.stride = firef_attribute_stride(a.mesh.attributes);
+
+    const char *end = data + size;
+    const char *begin = data;
+    for (int i = 0; i < chunk_count; i++) {
+        const char *split = i == chunk_count - 1 ? end : data + size / (size_t)chunk_count * (size_t)(i + 1);
+        if (split < begin) split = begin;
+        if (split < end) {
+            const char *eol = (const char*)memchr(split, '\n', (size_t)(end - split));
+            split = eol ? eol + 1 : end;
+        }
+        a.chunks[i].begin = begin;
+        a.chunks[i].end = split;
+        a.chunks[i].attributes = a.mesh.attributes;
+        a.chunks[i].control = control;
+        a.chunks[i].scratch = a.scratch;
+        begin = split;
+    }
+    a.chunk_count = chunk_count;
+    a.exact = options && (options->flags & FIREF_LOAD_EXACT_SIZE);
+
+    int status = 0;
+    if (a.exact) {
+        firef_parallel_for(a.scratch, chunk_count, firef_count_chunk, &a);
+        status = firef_presize_chunks(&a);
+    }
+    if (status == 0) firef_parallel_for(a.scratch, chunk_count, firef_parse_chunk, &a);
+
+    size_t corner_total = 0, tri_total = 0;
+    FirefBounds bounds;
+    memset(&bounds, 0, sizeof(bounds));
+    for (int i = 0; i < chunk_count; i++) {
+        FirefChunk *c = &a.chunks[i];
+        if (c->status != 0) status = c->status;
+        firef_bounds_merge(&bounds, &c->bounds);
+        c->pos_base = a.pos_count / 3;
+        c->uv_base = a.uv_count / 2;
+        c->norm_base = a.norm_count / 3;
+        c->corner_base = corner_total;
+        c->tri_base = tri_total;
+        a.pos_count += c->pos_len;
+        a.uv_count += c->uv_len;
+        a.norm_count += c->norm_len;
+        corner_total += c->corner_len;
+        tri_total += c->tri_count;
+    }
+    if (status == 0 && corner_total > UINT_MAX) {
+        fprintf(stderr, "Too many face vertices for 32-bit indices\n");
+        status = -1;
+    }
+
+    float *positions = NULL, *uvs = NULL, *normals = NULL;
+    if (status == 0) {
+        positions = firef_merge_attribute(&a, 0, a.pos_count);
+        uvs = firef_merge_attribute(&a, 1, a.uv_count);
+        normals = firef_merge_attribute(&a, 2, a.norm_count);
+        a.positions = positions;
+        a.uvs = uvs;
+        a.normals = normals;
+        a.pos_count /= 3;
+        a.uv_count /= 2;
+        a.norm_count /= 3;
+
+        a.mesh.indices = (unsigned int*)firef_alloc(a.mesh.arena, (tri_total ? tri_total : 1) * 3 * sizeof(unsigned int));
+        if ((!positions && a.pos_count && (a.mesh.attributes & FIREF_LOAD_POSITIONS)) ||
+            (!uvs && a.uv_count && (a.mesh.attributes & FIREF_LOAD_UVS)) ||
+            (!normals && a.norm_count && (a.mesh.attributes & FIREF_LOAD_NORMALS)) ||
+            firef_alloc_vertices(&a.mesh, corner_total) != 0 || !a.mesh.indices) {
+            status = -1;
+        }
+    }
+
+    size_t vertex_total = corner_total;
+    if (status == 0 && options && (options->flags & FIREF_LOAD_DEDUPLICATE)) {
+        vertex_total = firef_assemble_deduplicated(&a, corner_total);
+        if (vertex_total == (size_t)-1) {
+            status = -1;
+        } else if (vertex_total < corner_total) {
+            firef_shrink_vertices(&a.mesh, vertex_total);
+        }
+    } else if (status == 0) {
+        firef_parallel_for(a.scratch, chunk_count, firef_assemble_chunk, &a);
+        for (int i = 0; i < chunk_count; i++) {
+            if (a.chunks[i].status != 0) status = a.chunks[i].status;
+        }
+    }
+
+    for (int i = 0; i < (a.exact ? 1 : chunk_count); i++) firef_free_chunk(&a.chunks[i]);
+    firef_free(a.scratch, a.chunks);
+    firef_free(a.scratch, positions);
+    firef_free(a.scratch, uvs);
+    firef_free(a.scratch, normals);
+    if (a.scratch) obj_arena_reset(a.scratch);
+
+    if (status != 0) {
+        free_obj(&a.mesh);
+        return status;
+    }
+
+    *out = a.mesh;
+    firef_bounds_finish(&bounds, &out->bounds);
+    out->vertex_count = vertex_total * a.mesh.stride;
+    out->index_count = tri_total * 3;
+    out->index_size = 4;
+
+    if (options && (options->flags & FIREF_LOAD_GENERATE_NORMALS) && a.norm_count == 0 &&
+        (out->attributes & FIREF_LOAD_NORMALS) &&
+        firef_generate_normals(a.scratch, out, options->smoothing_angle, options->normal_weighting, threads) != 0) {
+        fprintf(stderr, "Failed to generate normals\n");
+        status = -1;
+    }
+    if (status == 0 && (out->attributes & FIREF_LOAD_TANGENTS) && firef_generate_tangents(a.scratch, out, threads) != 0) {
+        fprintf(stderr, "Failed to generate tangents (uvs and normals are required)\n");
+        status = -1;
+    }
+    if (a.scratch) obj_arena_reset(a.scratch);
+    if (status != 0) {
+        free_obj(out);
+        return -1;
+    }
+
+    // Generated normals and tangents split vertices, so count them again.
+    vertex_total = out->vertex_count / out->stride;
+    unsigned int index_size = firef_index_size(options ? options->index_format : OBJ_INDEX_32, vertex_total);
+    if (index_size == 0) {
+        fprintf(stderr, "Too many vertices for 16-bit indices (%zu)\n", vertex_total);
+        free_obj(out);
+        return -1;
+    }
+    if (index_size == 2) firef_narrow_indices(out);
+    return 0;
+}
+
+static char *firef_cache_path(const char *path) {
+    size_t len = strlen(path);
+    char *cache_path = (char*)FIREF_MALLOC(len + sizeof(FIREF_CACHE_EXTENSION));
+    if (!cache_path) return NULL;
+    memcpy(cache_path, path, len);
+    memcpy(cache_path + len, FIREF_CACHE_EXTENSION, sizeof(FIREF_CACHE_EXTENSION));
+    return cache_path;
+}
+
+// FNV-1a, 64-bit.
+static uint64_t firef_hash_update(uint64_t hash, const char *data, size_t size) {
+    for (size_t i = 0; i < size; i++) {
+        hash ^= (unsigned char)data[i];
+        hash *= 0x100000001B3ULL;
+    }
+    return hash;
+}
+
+static uint64_t firef_hash_bytes(const char *data, size_t size) {
+    return firef_hash_update(0xCBF29CE484222325ULL, data, size);
+}
+
+// Hash of the whole source that keys the sidecar. FNV-1a steps over
+// 64-bit words in four independent lanes run at memory speed, where a
+// byte at a time would take about as long as parsing the file.
+static uint64_t firef_source_hash(const char *data, size_t size) {
+    uint64_t lanes[4] = {
+        0xCBF29CE484222325ULL, 0x84222325CBF29CE4ULL,
+        0x9E3779B97F4A7C15ULL, 0xC2B2AE3D27D4EB4FULL
+    };
+    size_t i = 0;
+    for (; i + 32 <= size; i += 32) {
+        for (int lane = 0; lane < 4; lane++) {
+            uint64_t word;
+            memcpy(&word, data + i + lane * 8, 8);
+            lanes[lane] = (lanes[lane] ^ word) * 0x100000001B3ULL;
+        }
+    }
+    uint64_t hash = firef_hash_update(0xCBF29CE484222325ULL, data + i, size - i);
+    for (int lane = 0; lane < 4; lane++) {
+        hash = firef_hash_update(hash, (const char*)&lanes[lane], sizeof(lanes[lane]));
+    }
+    return firef_hash_update(hash, (const char*)&size, sizeof(size));
+}
+
+// Sub-second part of the modification time where struct stat has one
+// (st_mtime is then a macro for its seconds), 0 elsewhere.
+static int64_t firef_mtime_nsec(const struct stat *st) {
+#if defined(__APPLE__) && defined(st_mtime)
+    return (int64_t)st->st_mtimespec.tv_nsec;
+#elif defined(st_mtime)
+    return (int64_t)st->st_mtim.tv_nsec;
+#else
+    (void)st;
+    return 0;
+#endif
+}
+
+static void firef_cache_header(FirefCacheHeader *header, const ObjLoadOptions *options, const struct stat *source) {
+    unsigned int flags = options ? options->flags : 0;
+    ObjLayout layout = options ? options->layout : OBJ_LAYOUT_AOS;
+    memset(header, 0, sizeof(*header));
+    memcpy(header->magic, "FIREFBIN", 8);
+    header->version = FIREF_CACHE_VERSION;
+    header->byte_order = 0x01020304u;
+    header->flags = (flags & FIREF_CACHE_FLAG_MASK & ~FIREF_LOAD_ALL_ATTRIBUTES) | firef_attribute_mask(flags);
+    header->layout = layout;
+    header->floats_per_vertex = firef_attribute_stride(firef_attribute_mask(flags));
+    header->source_size = (uint64_t)source->st_size;
+    header->source_mtime = (int64_t)source->st_mtime;
+    header->source_mtime_nsec = firef_mtime_nsec(source);
+    if (flags & FIREF_LOAD_GENERATE_NORMALS) {
+        header->smoothing_angle = options->smoothing_angle;
+        header->normal_weighting = (uint32_t)options->normal_weighting;
+    }
+}
+
+// Catches rewrites that keep the size and the timestamp.
+static int firef_source_matches(const char *path, uint64_t size, uint64_t hash) {
+    FirefFileView view;
+    if (firef_map_file(path, &view) != 0) return 0;
+    int matches = view.size == size && firef_source_hash(view.data, view.size) == hash;
+    firef_unmap_file(&view);
+    return matches;
+}
+
+static int firef_load_cache(const char *path, const ObjLoadOptions *options, Obj *out) {
+    unsigned int flags = options ? options->flags : 0;
+    ObjLayout layout = options ? options->layout : OBJ_LAYOUT_AOS;
+    ObjIndexFormat index_format = options ? options->index_format : OBJ_INDEX_32;
+    struct stat source;
+    if (stat(path, &source) != 0) return -1;
+    char *cache_path = firef_cache_path(path);
+    if (!cache_path) return -1;
+
+    FirefFileView view;
+    int status = firef_map_file(cache_path, &view);
+    FIREF_FREE(cache_path);
+    if (status != 0) return -1;
+
+    FirefCacheHeader expected, header;
+    firef_cache_header(&expected, options, &source);
+    status = -1;
+    if (view.size >= sizeof(header)) {
+        memcpy(&header, view.data, sizeof(header));
+        uint64_t vertex_bytes = header.vertex_count * sizeof(float);
+        uint64_t index_bytes = header.index_count * header.index_size;
+        if (memcmp(header.magic, expected.magic, 8) == 0 &&
+            header.version == expected.version &&
+            header.byte_order == expected.byte_order &&
+            header.flags == expected.flags &&
+            header.layout == expected.layout &&
+            header.floats_per_vertex == expected.floats_per_vertex &&
+            header.vertex_count % header.floats_per_vertex == 0 &&
+            header.index_size == firef_index_size(index_format, (size_t)(header.vertex_count / header.floats_per_vertex)) &&
+            header.source_size == expected.source_size &&
+            header.source_mtime == expected.source_mtime &&
+            header.source_mtime_nsec == expected.source_mtime_nsec &&
+            header.smoothing_angle == expected.smoothing_angle &&
+            header.normal_weighting == expected.normal_weighting &&
+            header.vertex_offset <= view.size && vertex_bytes <= view.size - header.vertex_offset &&
+            header.index_offset <= view.size && index_bytes <= view.size - header.index_offset &&
+            firef_source_matches(path, header.source_size, header.source_hash)) {
+            memset(out, 0, sizeof(*out));
+            out->arena = options ? options->output_arena : NULL;
+            out->layout = layout;
+            out->attributes = firef_attribute_mask(flags);
+            out->stride = header.floats_per_vertex;
+            out->vertex_count = (size_t)header.vertex_count;
+            out->index_count = (size_t)header.index_count;
+            out->index_size = header.index_size;
+            out->bounds = header.bounds;
+            void *indices = firef_alloc(out->arena, index_bytes ? (size_t)index_bytes : 1);
+            if (out->index_size == 2) {
+                out->indices16 = (uint16_t*)indices;
+            } else {
+                out->indices = (unsigned int*)indices;
+            }
+            if (indices && firef_alloc_vertices(out, out->vertex_count / out->stride) == 0) {
+                float *streams[FIREF_ATTRIBUTE_COUNT];
+                size_t lengths[FIREF_ATTRIBUTE_COUNT];
+                const char *src = view.data + header.vertex_offset;
+                int stream_count = firef_vertex_streams(out, streams, lengths);
+                for (int i = 0; i < stream_count; i++) {
+                    memcpy(streams[i], src, lengths[i] * sizeof(float));
+                    src += lengths[i] * sizeof(float);
+                }
+                memcpy(indices, view.data + header.index_offset, (size_t)index_bytes);
+                status = 0;
+            } else {
+                free_obj(out);
+            }
+        }
+    }
+    firef_unmap_file(&view);
+    return status;
+}
+
+static int firef_write_padding(FILE *file, uint64_t *offset) {
+    static const char zeros[FIREF_CACHE_ALIGNMENT] = {0};
+    size_t pad = (size_t)((FIREF_CACHE_ALIGNMENT - *offset % FIREF_CACHE_ALIGNMENT) % FIREF_CACHE_ALIGNMENT);
+    *offset += pad;
+    return fwrite(zeros, 1, pad, file) == pad ? 0 : -1;
+}
+
+// Writes the sidecar next to path. The data goes to a temporary file
+// first and is renamed into place, so readers never see a partial file.
+static int firef_write_cache(const char *path, const FirefFileView *source_view, const ObjLoadOptions *options, const Obj *obj) {
+    struct stat source;
+    if (stat(path, &source) != 0 || (uint64_t)source.st_size != source_view->size) return -1;
+
+    char *cache_path = firef_cache_path(path);
+    if (!cache_path) return -1;
+    size_t len = strlen(cache_path);
+    char *tmp_path = (char*)FIREF_MALLOC(len + 5);
+    if (!tmp_path) {
+        FIREF_FREE(cache_path);
+        return -1;
+    }
+    memcpy(tmp_path, cache_path, len);
+    memcpy(tmp_path + len, ".tmp", 5);
+
+    FirefCacheHeader header;
+    firef_cache_header(&header, options, &source);
+    header.source_hash = firef_source_hash(source_view->data, source_view->size);
+    header.vertex_count = obj->vertex_count;
+    header.index_count = obj->index_count;
+    header.index_size = obj->index_size;
+    header.bounds = obj->bounds;
+    uint64_t offset = sizeof(header);
+    offset += (FIREF_CACHE_ALIGNMENT - offset % FIREF_CACHE_ALIGNMENT) % FIREF_CACHE_ALIGNMENT;
+    header.vertex_offset = offset;
+    offset += obj->vertex_count * sizeof(float);
+    offset += (FIREF_CACHE_ALIGNMENT - offset % FIREF_CACHE_ALIGNMENT) % FIREF_CACHE_ALIGNMENT;
+    header.index_offset = offset;
+
+    int status = -1;
+    FILE *file = fopen(tmp_path, "wb");
+    if (file) {
+        offset = sizeof(header);
+        status = fwrite(&header, sizeof(header), 1, file) == 1 ? 0 : -1;
+        if (status == 0) status = firef_write_padding(file, &offset);
+        float *streams[FIREF_ATTRIBUTE_COUNT];
+        size_t lengths[FIREF_ATTRIBUTE_COUNT];
+        int stream_count = firef_vertex_streams(obj, streams, lengths);
+        for (int i = 0; i < stream_count && status == 0; i++) {
+            if (fwrite(streams[i], sizeof(float), lengths[i], file) != lengths[i]) status = -1;
+        }
+        offset += obj->vertex_count * sizeof(float);
+        if (status == 0) status = firef_write_padding(file, &offset);
+        const void *indices = obj->index_size == 2 ? (const void*)obj->indices16 : (const void*)obj->indices;
+        if (status == 0 && fwrite(indices, obj->index_size, obj->index_count, file) != obj->index_count) status = -1;
+        if (fclose(file) != 0) status = -1;
+#if defined(_WIN32)
+        if (status == 0) remove(cache_path);
+#endif
+        if (status == 0 && rename(tmp_path, cache_path) != 0) status = -1;
+        if (status != 0) remove(tmp_path);
+    }
+
+    FIREF_FREE(tmp_path);
+    FIREF_FREE(cache_path);
+    return status;
+}
+
+// load_obj_ex without the exit: reports what went wrong instead.
+static ObjLoadStatus firef_load_path(const char *path, const ObjLoadOptions *options, FirefLoadControl *control, Obj *out) {
+    unsigned int flags = options ? options->flags : 0;
+    if (!(flags & FIREF_LOAD_NO_CACHE) && firef_load_cache(path, options, out) == 0) {
+        return OBJ_LOAD_OK;
+    }
+
+    FirefFileView view;
+    if (firef_map_file(path, &view) != 0) return OBJ_LOAD_OPEN_FAILED;
+    if (control) firef_atomic_store(&control->size, view.size);
+
+    int status = firef_parse_obj(view.data, view.size, options, control, out);
+    if (status == 0 && (flags & FIREF_LOAD_WRITE_CACHE) && firef_write_cache(path, &view, options, out) != 0) {
+        fprintf(stderr, "Failed to write %s%s\n", path, FIREF_CACHE_EXTENSION);
+    }
+    firef_unmap_file(&view);
+    if (status != 0 && control && firef_atomic_load(&control->cancelled)) return OBJ_LOAD_CANCELLED;
+    return status == 0 ? OBJ_LOAD_OK : OBJ_LOAD_PARSE_FAILED;
+}
+
+Obj load_obj_ex(const char *path, const ObjLoadOptions *options) {
+    Obj obj;
+    ObjLoadStatus status = firef_load_path(path, options, NULL, &obj);
+    if (status == OBJ_LOAD_OPEN_FAILED) {
+        fprintf(stderr, "Failed to open %s\n", path);
+        exit(1);
+    }
+    if (status != OBJ_LOAD_OK) {
+        fprintf(stderr, "Failed to parse %s\n", path);
+        exit(1);
+    }
+    return obj;
+}
+
+Obj load_obj(const char *path) {
+    return load_obj_ex(path, NULL);
+}
+
+Obj load_obj_from_memory_ex(const char *data, size_t len, const ObjLoadOptions *options) {
+    Obj obj;
+    if (firef_parse_obj(data, len, options, NULL, &obj) != 0) {
+        fprintf(stderr, "Failed to parse OBJ from memory\n");
+        exit(1);
+    }
+    return obj;
+}
+
+Obj load_obj_from_memory(const char *data, size_t len) {
+    return load_obj_from_memory_ex(data, len, NULL);
+}
+
+// Lock for the batch queues; does nothing without threads.
+#if defined(FIREF_HAS_THREADS) && defined(_WIN32)
+typedef CRITICAL_SECTION FirefMutex;
+static inline void firef_mutex_init(FirefMutex *m) { InitializeCriticalSection(m); }
+static inline void firef_mutex_destroy(FirefMutex *m) { DeleteCriticalSection(m); }
+static inline void firef_mutex_lock(FirefMutex *m) { EnterCriticalSection(m); }
+static inline void firef_mutex_unlock(FirefMutex *m) { LeaveCriticalSection(m); }
+#elif defined(FIREF_HAS_THREADS)
+typedef pthread_mutex_t FirefMutex;
+static inline void firef_mutex_init(FirefMutex *m) { pthread_mutex_init(m, NULL); }
+static inline void firef_mutex_destroy(FirefMutex *m) { pthread_mutex_destroy(m); }
+static inline void firef_mutex_lock(FirefMutex *m) { pthread_mutex_lock(m); }
+static inline void firef_mutex_unlock(FirefMutex *m) { pthread_mutex_unlock(m); }
+#else
+typedef int FirefMutex;
+static inline void firef_mutex_init(FirefMutex *m) { (void)m; }
+static inline void firef_mutex_destroy(FirefMutex *m) { (void)m; }
+static inline void firef_mutex_lock(FirefMutex *m) { (void)m; }
+static inline void firef_mutex_unlock(FirefMutex *m) { (void)m; }
+#endif
+
+// One worker's files, biggest first. The owner and thieves both take
+// from head, so a steal moves the largest file still pending off the
+// owner instead of its smallest.
+typedef struct {
+    FirefMutex lock;
+    size_t *items;
+    size_t head, tail;
+} FirefBatchQueue;
+
+typedef struct {
+    const char *const *paths;
+    const ObjLoadOptions *options;
+    Obj *out;
+    ObjLoadStatus *status;
+    FirefBatchQueue *queues;
+    int queue_count;
+} FirefBatch;
+
+typedef struct {
+    uint64_t size;
+    size_t index;
+} FirefBatchFile;
+
+static int firef_batch_compare(const void *a, const void *b) {
+    const FirefBatchFile *fa = (const FirefBatchFile*)a, *fb = (const FirefBatchFile*)b;
+    if (fa->size != fb->size) return fa->size > fb->size ? -1 : 1;
+    return (fa->index > fb->index) - (fa->index < fb->index);
+}
+
+static int firef_batch_take(FirefBatch *b, int self, size_t *item) {
+    for (int k = 0; k < b->queue_count; k++) {
+        FirefBatchQueue *q = &b->queues[(self + k) % b->queue_count];
+        int found = 0;
+        firef_mutex_lock(&q->lock);
+        if (q->head < q->tail) {
+            *item = q->items[q->head++];
+            found = 1;
+        }
+        firef_mutex_unlock(&q->lock);
+        if (found) return 1;
+    }
+    return 0;
+}
+
+// Each worker keeps one scratch arena for all its files, so loads on
+// different workers never meet in the allocator for temporaries.
+static void firef_batch_worker(void *ctx, int index) {
+    FirefBatch *b = (FirefBatch*)ctx;
+    ObjArena scratch;
+    obj_arena_init(&scratch, NULL, 0);
+    ObjLoadOptions options;
+    memset(&options, 0, sizeof(options));
+    if (b->options) options = *b->options;
+    options.scratch_arena = &scratch;
+
+    size_t i;
+    while (firef_batch_take(b, index, &i)) {
+        ObjLoadStatus status = firef_load_path(b->paths[i], &options, NULL, &b->out[i]);
+        if (status != OBJ_LOAD_OK) memset(&b->out[i], 0, sizeof(Obj));
+        b->status[i] = status;
+    }
+    obj_arena_free(&scratch);
+}
+
+size_t load_obj_batch_ex(const char *const *paths, size_t count, const ObjLoadOptions *options, Obj *out, ObjLoadStatus *status, int threads) {
+    if (count == 0) return 0;
+    int queue_count = threads > 1 ? threads : 1;
+    if ((size_t)queue_count > count) queue_count = (int)count;
+
+    FirefBatchFile *files = (FirefBatchFile*)FIREF_MALLOC(count * sizeof(FirefBatchFile));
+    size_t *items = (size_t*)FIREF_MALLOC(count * sizeof(size_t));
+    FirefBatchQueue *queues = (FirefBatchQueue*)firef_calloc((size_t)queue_count, sizeof(FirefBatchQueue));
+    ObjLoadStatus *statuses = status ? status : (ObjLoadStatus*)FIREF_MALLOC(count * sizeof(ObjLoadStatus));
+    if (!files || !items || !queues || !statuses) {
+        // Too little memory to plan the batch: load in order, one by one.
+        queue_count = 0;
+    }
+
+    if (queue_count > 0) {
+        for (size_t i = 0; i < count; i++) {
+            struct stat st;
+            files[i].size = stat(paths[i], &st) == 0 ? (uint64_t)st.st_size : 0;
+            files[i].index = i;
+        }
+        qsort(files, count, sizeof(FirefBatchFile), firef_batch_compare);
+
+        // Queue q holds the q-th, (q + queue_count)-th, ... biggest files.
+        size_t at = 0;
+        for (int q = 0; q < queue_count; q++) {
+            firef_mutex_init(&queues[q].lock);
+            queues[q].items = items + at;
+            for (size_t i = (size_t)q; i < count; i += (size_t)queue_count) items[at++] = files[i].index;
+            queues[q].tail = (size_t)(items + at - queues[q].items);
+        }
+
+        FirefBatch batch;
+        batch.paths = paths;
+        batch.options = options;
+        batch.out = out;
+        batch.status = statuses;
+        batch.queues = queues;
+        batch.queue_count = queue_count;
+        firef_parallel_for(NULL, queue_count, firef_batch_worker, &batch);
+        for (int q = 0; q < queue_count; q++) firef_mutex_destroy(&queues[q].lock);
+    }
+
+    size_t failed = 0;
+    for (size_t i = 0; i < count; i++) {
+        ObjLoadStatus result;
+        if (queue_count > 0) {
+            result = statuses[i];
+        } else {
+            result = firef_load_path(paths[i], options, NULL, &out[i]);
+            if (result != OBJ_LOAD_OK) memset(&out[i], 0, sizeof(Obj));
+            if (status) status[i] = result;
+        }
+        failed += result != OBJ_LOAD_OK;
+    }
+
+    FIREF_FREE(files);
+    FIREF_FREE(items);
+    FIREF_FREE(queues);
+    if (statuses != status) FIREF_FREE(statuses);
+    return failed;
+}
+
+size_t load_obj_batch(const char *const *paths, size_t count, Obj *out, int threads) {
+    return load_obj_batch_ex(paths, count, NULL, out, NULL, threads);
+}
+
+struct ObjLoadJob {
+    char *path;
+    ObjLoadOptions options;
+    int has_options;
+    ObjLoadCallback callback;
+    void *user;
+    FirefLoadControl control;
+    uint64_t done;
+    ObjLoadStatus status;
+    Obj obj;
+#ifdef FIREF_HAS_THREADS
+    FirefThreadTask task;
+    int started;
+#if defined(_WIN32)
+    HANDLE thread;
+#else
+    pthread_t thread;
+#endif
+#endif
+};
+
+static void firef_load_job(void *ctx, int index) {
+    ObjLoadJob *job = (ObjLoadJob*)ctx;
+    (void)index;
+    job->status = firef_load_path(job->path, job->has_options ? &job->options : NULL, &job->control, &job->obj);
+    if (job->status != OBJ_LOAD_OK) memset(&job->obj, 0, sizeof(Obj));
+    if (job->callback) job->callback(job, job->status, job->user);
+    firef_atomic_store(&job->done, 1);
+}
+
+ObjLoadJob *load_obj_async(const char *path, const ObjLoadOptions *options, ObjLoadCallback callback, void *user) {
+    ObjLoadJob *job = (ObjLoadJob*)firef_calloc(1, sizeof(ObjLoadJob));
+    size_t len = strlen(path);
+    char *copy = (char*)FIREF_MALLOC(len + 1);
+    if (!job || !copy) {
+        FIREF_FREE(job);
+        FIREF_FREE(copy);
+        return NULL;
+    }
+    memcpy(copy, path, len + 1);
+    job->path = copy;
+    if (options) job->options = *options;
+    job->has_options = options != NULL;
+    job->callback = callback;
+    job->user = user;
+
+#ifdef FIREF_HAS_THREADS
+    job->task.fn = firef_load_job;
+    job->task.ctx = job;
+    job->task.index = 0;
+#if defined(_WIN32)
+    job->thread = CreateThread(NULL, 0, firef_thread_main, &job->task, 0, NULL);
+    job->started = job->thread != NULL;
+#else
+    job->started = pthread_create(&job->thread, NULL, firef_thread_main, &job->task) == 0;
+#endif
+    if (job->started) return job;
+#endif
+    firef_load_job(job, 0);
+    return job;
+}
+
+int obj_load_poll(const ObjLoadJob *job) {
+    return firef_atomic_load((uint64_t*)&job->done) != 0;
+}
+
+float obj_load_progress(const ObjLoadJob *job) {
+    if (obj_load_poll(job)) return 1.0f;
+    uint64_t size = firef_atomic_load((uint64_t*)&job->control.size);
+    uint64_t consumed = firef_atomic_load((uint64_t*)&job->control.consumed);
+    if (size == 0) return 0.0f;
+    return consumed >= size ? 1.0f : (float)((double)consumed / (double)size);
+}
+
+void obj_load_cancel(ObjLoadJob *job) {
+    firef_atomic_store(&job->control.cancelled, 1);
+}
+
+ObjLoadStatus obj_load_wait(ObjLoadJob *job, Obj *out) {
+#ifdef FIREF_HAS_THREADS
+    if (job->started) {
+#if defined(_WIN32)
+        WaitForSingleObject(job->thread, INFINITE);
+        CloseHandle(job->thread);
+#else
+        pthread_join(job->thread, NULL);
+#endif
+    }
+#endif
+    ObjLoadStatus status = job->status;
+    *out = job->obj;
+    FIREF_FREE(job->path);
+    FIREF_FREE(job);
+    return status;
+}
+
+void free_obj(Obj *obj) {
+    firef_free(obj->arena, obj->vertices);
+    firef_free(obj->arena, obj->indices);
+    firef_free(obj->arena, obj->indices16);
+    if (obj->layout == OBJ_LAYOUT_SOA) firef_aligned_free(obj->arena, firef_soa_block(obj));
+}
+
+static inline size_t firef_obj_vertex_total(const Obj *obj) {
+    return obj->vertex_count / (obj->stride ? obj->stride : 8);
+}
+
+// Lists the triangles around every vertex in CSR form: those of vertex v
+// are adjacency[offsets[v]] up to adjacency[offsets[v + 1]], in index
+// order. Corner i belongs to vertex remap[indices[i]], or indices[i] when
+// remap is NULL; with by_corner the entries are the corners themselves
+// instead of their triangles i / 3. offsets needs vertex_count + 1
+// entries and adjacency corner_count.
+static void firef_build_vertex_triangles(const unsigned int *indices, size_t corner_count, const unsigned int *remap,
+                                         size_t vertex_count, int by_corner, size_t *offsets, unsigned int *adjacency) {
+    memset(offsets, 0, (vertex_count + 1) * sizeof(size_t));
+    for (size_t i = 0; i < corner_count; i++) offsets[(remap ? remap[indices[i]] : indices[i]) + 1]++;
+    for (size_t v = 0; v < vertex_count; v++) offsets[v + 1] += offsets[v];
+    for (size_t i = 0; i < corner_count; i++) {
+        size_t v = remap ? remap[indices[i]] : indices[i];
+        adjacency[offsets[v]++] = (unsigned int)(by_corner ? i : i / 3);
+    }
+    for (size_t v = vertex_count; v > 0; v--) offsets[v] = offsets[v - 1];
+    offsets[0] = 0;
+}
+
+void obj_analyze_vertex_cache(const Obj *obj, unsigned int cache_size, float *acmr, float *atvr) {
+    size_t vertex_total = firef_obj_vertex_total(obj);
+    size_t tri_count = obj->index_count / 3;
+    *acmr = 0.0f;
+    *atvr = 0.0f;
+    if (tri_count == 0 || cache_size == 0) return;
+
+    // FIFO cache: a vertex stays resident until cache_size further misses
+    // have happened since it was loaded.
+    size_t *loaded_at = (size_t*)FIREF_MALLOC((vertex_total ? vertex_total : 1) * sizeof(size_t));
+    if (!loaded_at) return;
+    for (size_t v = 0; v < vertex_total; v++) loaded_at[v] = (size_t)-1;
+
+    size_t misses = 0, referenced = 0;
+    for (size_t i = 0; i < tri_count * 3; i++) {
+        unsigned int v = firef_index_at(obj, i);
+        if (v >= vertex_total) continue;
+        if (loaded_at[v] == (size_t)-1) referenced++;
+        if (loaded_at[v] == (size_t)-1 || misses - loaded_at[v] >= cache_size) {
+            loaded_at[v] = misses++;
+        }
+    }
+    FIREF_FREE(loaded_at);
+
+    *acmr = (float)misses / (float)tri_count;
+    *atvr = referenced ? (float)misses / (float)referenced : 0.0f;
+}
+
+// Tipsify: fan out from the current vertex, emitting all of its remaining
+// triangles, then continue with the candidate vertex that will still be
+// in cache and has the most triangles left. When no candidate qualifies,
+// fall back to recently used vertices (the dead-end stack) and finally to
+// the next vertex in index order.
+int obj_optimize_vertex_cache(Obj *obj, unsigned int cache_size, ObjCacheStats *stats) {
+    size_t vertex_total = firef_obj_vertex_total(obj);
+    size_t tri_count = obj->index_count / 3;
+    ObjCacheStats result;
+    obj_analyze_vertex_cache(obj, cache_size, &result.acmr_before, &result.atvr_before);
+    result.acmr_after = result.acmr_before;
+    result.atvr_after = result.atvr_before;
+    if (stats) *stats = result;
+    if (tri_count == 0 || vertex_total == 0 || cache_size == 0) return 0;
+
+    for (size_t i = 0; i < tri_count * 3; i++) {
+        if (firef_index_at(obj, i) >= vertex_total) return -1;
+    }
+
+    size_t *offsets = (size_t*)FIREF_MALLOC((vertex_total + 1) * sizeof(size_t));
+    unsigned int *adjacency = (unsigned int*)FIREF_MALLOC(tri_count * 3 * sizeof(unsigned int));
+    unsigned int *live = (unsigned int*)FIREF_MALLOC(vertex_total * sizeof(unsigned int));
+    size_t *cache_time = (size_t*)firef_calloc(vertex_total, sizeof(size_t));
+    unsigned int *dead_end = (unsigned int*)FIREF_MALLOC(tri_count * 3 * sizeof(unsigned int));
+    unsigned char *emitted = (unsigned char*)firef_calloc(tri_count, 1);
+    unsigned int *output = (unsigned int*)FIREF_MALLOC(tri_count * 3 * sizeof(unsigned int));
+    unsigned int *indices = (unsigned int*)FIREF_MALLOC(tri_count * 3 * sizeof(unsigned int));
+    int status = -1;
+
+    if (offsets && adjacency && live && cache_time && dead_end && emitted && output && indices) {
+        for (size_t i = 0; i < tri_count * 3; i++) indices[i] = firef_index_at(obj, i);
+        firef_build_vertex_triangles(indices, tri_count * 3, NULL, vertex_total, 0, offsets, adjacency);
+        for (size_t v = 0; v < vertex_total; v++) live[v] = (unsigned int)(offsets[v + 1] - offsets[v]);
+
+        size_t timestamp = (size_t)cache_size + 1;
+        size_t dead_end_len = 0, out_len = 0, cursor = 0;
+        long fanning = 0;
+
+        while (fanning >= 0) {
+            size_t candidates_begin = dead_end_len;
+
+            for (size_t k = offsets[fanning]; k < offsets[fanning + 1]; k++) {
+                size_t t = adjacency[k];
+                if (emitted[t]) continue;
+                emitted[t] = 1;
+                for (int c = 0; c < 3; c++) {
+                    unsigned int v = indices[t * 3 + c];
+                    output[out_len++] = v;
+                    dead_end[dead_end_len++] = v;
+                    live[v]--;
+                    if (timestamp - cache_time[v] > cache_size) cache_time[v] = timestamp++;
+                }
+            }
+
+            // The vertices just pushed on the dead-end stack are the
+            // candidates, but only those that would still be in the cache
+            // after fanning out; otherwise fall back to the dead-end stack.
+            long best = -1;
+            size_t best_priority = 0;
+            for (size_t k = candidates_begin; k < dead_end_len; k++) {
+                unsigned int v = dead_end[k];
+                if (live[v] == 0) continue;
+                size_t priority = 0;
+                if (timestamp - cache_time[v] + 2 * (size_t)live[v] <= cache_size) priority = timestamp - cache_time[v];
+                if (priority > best_priority) {
+                    best = (long)v;
+                    best_priority = priority;
+                }
+            }
+
+            while (best < 0 && dead_end_len > 0) {
+                unsigned int v = dead_end[--dead_end_len];
+                if (live[v] > 0) best = (long)v;
+            }
+            while (best < 0 && cursor < vertex_total) {
+                if (live[cursor] > 0) best = (long)cursor;
+                cursor++;
+            }
+            fanning = best;
+        }
+
+        for (size_t i = 0; i < tri_count * 3; i++) firef_set_index(obj, i, output[i]);
+        status = 0;
+    }
+
+    FIREF_FREE(offsets);
+    FIREF_FREE(adjacency);
+    FIREF_FREE(live);
+    FIREF_FREE(cache_time);
+    FIREF_FREE(dead_end);
+    FIREF_FREE(emitted);
+    FIREF_FREE(output);
+    FIREF_FREE(indices);
+    if (status != 0) return status;
+
+    obj_analyze_vertex_cache(obj, cache_size, &result.acmr_after, &result.atvr_after);
+    if (stats) *stats = result;
+    return 0;
+}
+
+// Moves every vertex v to slot remap[v]; remap must be a permutation.
+static int firef_permute_vertices(Obj *obj, const unsigned int *remap) {
+    size_t vertex_total = firef_obj_vertex_total(obj);
+    Obj moved = *obj;
+    if (firef_alloc_vertices(&moved, vertex_total) != 0) return -1;
+
+    float *from[FIREF_ATTRIBUTE_COUNT], *to[FIREF_ATTRIBUTE_COUNT];
+    size_t lengths[FIREF_ATTRIBUTE_COUNT];
+    int stream_count = firef_vertex_streams(obj, from, lengths);
+    firef_vertex_streams(&moved, to, lengths);
+    for (int i = 0; i < stream_count; i++) {
+        size_t components = vertex_total ? lengths[i] / vertex_total : 0;
+        for (size_t v = 0; v < vertex_total; v++) {
+            memcpy(to[i] + (size_t)remap[v] * components, from[i] + v * components, components * sizeof(float));
+        }
+    }
+
+    firef_replace_vertices(obj, &moved);
+    return 0;
+}
+
+int obj_optimize_vertex_fetch(Obj *obj, unsigned int *remap) {
+    size_t vertex_total = firef_obj_vertex_total(obj);
+    if (vertex_total == 0) return 0;
+    for (size_t i = 0; i < obj->index_count; i++) {
+        if (firef_index_at(obj, i) >= vertex_total) return -1;
+    }
+
+    unsigned int *table = remap ? remap : (unsigned int*)FIREF_MALLOC(vertex_total * sizeof(unsigned int));
+    if (!table) return -1;
+    memset(table, 0xFF, vertex_total * sizeof(unsigned int));
+
+    unsigned int next = 0;
+    for (size_t i = 0; i < obj->index_count; i++) {
+        unsigned int v = firef_index_at(obj, i);
+        if (table[v] == UINT_MAX) table[v] = next++;
+    }
+    for (size_t v = 0; v < vertex_total; v++) {
+        if (table[v] == UINT_MAX) table[v] = next++;
+    }
+
+    int status = firef_permute_vertices(obj, table);
+    if (status == 0) {
+        for (size_t i = 0; i < obj->index_count; i++) firef_set_index(obj, i, table[firef_index_at(obj, i)]);
+    }
+    if (!remap) FIREF_FREE(table);
+    return status;
+}
+
+// Float to IEEE half with round to nearest even; overflow becomes infinity.
+static inline uint16_t firef_float_to_half(float value) {
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    uint32_t sign = bits & 0x80000000u;
+    bits ^= sign;
+    uint16_t half;
+    if (bits >= (uint32_t)(127 + 16) << 23) {
+        half = bits > 0x7F800000u ? 0x7E00 : 0x7C00;
+    } else if (bits < (uint32_t)113 << 23) {
+        // Subnormal or zero: let the FPU round the mantissa into place.
+        const uint32_t magic_bits = (uint32_t)((127 - 15) + (23 - 10) + 1) << 23;
+        float magic, shifted;
+        memcpy(&magic, &magic_bits, sizeof(magic));
+        memcpy(&shifted, &bits, sizeof(shifted));
+        shifted += magic;
+        memcpy(&bits, &shifted, sizeof(bits));
+        half = (uint16_t)(bits - magic_bits);
+    } else {
+        uint32_t odd = (bits >> 13) & 1;
+        bits += ((uint32_t)(15 - 127) << 23) + 0xFFF + odd;
+        half = (uint16_t)(bits >> 13);
+    }
+    return (uint16_t)(half | (sign >> 16));
+}
+
+static inline float firef_clamp_unit(float value, float low) {
+    return value < low ? low : value > 1.0f ? 1.0f : value;
+}
+
+static inline int16_t firef_snorm16(float value) {
+    float scaled = firef_clamp_unit(value, -1.0f) * 32767.0f;
+    return (int16_t)(scaled < 0.0f ? scaled - 0.5f : scaled + 0.5f);
+}
+
+static inline uint32_t firef_snorm10(float value) {
+    float scaled = firef_clamp_unit(value, -1.0f) * 511.0f;
+    int32_t stored = (int32_t)(scaled < 0.0f ? scaled - 0.5f : scaled + 0.5f);
+    return (uint32_t)stored & 0x3FFu;
+}
+
+// Attribute floats of vertex v in either layout, NULL when not loaded.
+static inline const float *firef_vertex_attribute(const Obj *obj, size_t v, int attribute) {
+    if (!(obj->attributes & firef_attribute_bits[attribute])) return NULL;
+    if (obj->layout == OBJ_LAYOUT_SOA) {
+        return *firef_soa_stream((Obj*)obj, attribute) + v * firef_attribute_sizes[attribute];
+    }
+    size_t offset = 0;
+    for (int i = 0; i < attribute; i++) {
+        if (obj->attributes & firef_attribute_bits[i]) offset += firef_attribute_sizes[i];
+    }
+    return obj->vertices + v * obj->stride + offset;
+}
+
+static void firef_pack_normal(unsigned char *dst, const float *n, ObjNormalFormat format) {
+    if (format == OBJ_NORMAL_FLOAT) {
+        memcpy(dst, n, 3 * sizeof(float));
+        return;
+    }
+    if (format == OBJ_NORMAL_OCT16) {
+        // Project onto the octahedron |x|+|y|+|z| = 1 and fold the lower
+        // hemisphere over the diagonals.
+        float sum = fabsf(n[0]) + fabsf(n[1]) + fabsf(n[2]);
+        float x = sum > 0.0f ? n[0] / sum : 0.0f;
+        float y = sum > 0.0f ? n[1] / sum : 0.0f;
+        if (n[2] < 0.0f) {
+            float fx = (1.0f - fabsf(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+            float fy = (1.0f - fabsf(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+            x = fx;
+            y = fy;
+        }
+        int16_t oct[2] = { firef_snorm16(x), firef_snorm16(y) };
+        memcpy(dst, oct, sizeof(oct));
+        return;
+    }
+    float length = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+    float inv = length > 0.0f ? 1.0f / length : 0.0f;
+    uint32_t word = firef_snorm10(n[0] * inv) | firef_snorm10(n[1] * inv) << 10 | firef_snorm10(n[2] * inv) << 20;
+    memcpy(dst, &word, sizeof(word));
+}
+
+int obj_pack_vertices(const Obj *obj, ObjPositionFormat position, ObjUvFormat uv, ObjNormalFormat normal, ObjPackedVertices *out) {
+    static const unsigned int position_bytes[3] = { 12, 8, 8 };
+    static const unsigned int uv_bytes[2] = { 8, 4 };
+    static const unsigned int normal_bytes[3] = { 12, 4, 4 };
+
+    memset(out, 0, sizeof(*out));
+    out->vertex_count = firef_obj_vertex_total(obj);
+    out->position_format = position;
+    out->uv_format = uv;
+    out->normal_format = normal;
+    out->position_offset = out->uv_offset = out->normal_offset = -1;
+    if (obj->attributes & FIREF_LOAD_POSITIONS) {
+        out->position_offset = (int)out->stride;
+        out->stride += position_bytes[position];
+    }
+    if (obj->attributes & FIREF_LOAD_UVS) {
+        out->uv_offset = (int)out->stride;
+        out->stride += uv_bytes[uv];
+    }
+    if (obj->attributes & FIREF_LOAD_NORMALS) {
+        out->normal_offset = (int)out->stride;
+        out->stride += normal_bytes[normal];
+    }
+
+    out->data = (unsigned char*)FIREF_MALLOC(out->vertex_count * out->stride + 1);
+    if (!out->data) return -1;
+
+    // Quantization frame: HALF maps the bounds to [-1, 1] around their
+    // center, UNORM16 maps them to [0, 1] from the minimum corner.
+    float inv_scale[3] = { 1.0f, 1.0f, 1.0f };
+    for (int k = 0; k < 3; k++) out->position_scale[k] = 1.0f;
+    if (out->position_offset >= 0 && position != OBJ_POSITION_FLOAT && out->vertex_count > 0) {
+        float lo[3], hi[3];
+        const float *p = firef_vertex_attribute(obj, 0, 0);
+        memcpy(lo, p, sizeof(lo));
+        memcpy(hi, p, sizeof(hi));
+        for (size_t v = 1; v < out->vertex_count; v++) {
+            p = firef_vertex_attribute(obj, v, 0);
+            for (int k = 0; k < 3; k++) {
+                if (p[k] < lo[k]) lo[k] = p[k];
+                if (p[k] > hi[k]) hi[k] = p[k];
+            }
+        }
+        for (int k = 0; k < 3; k++) {
+            float extent = hi[k] - lo[k];
+            if (position == OBJ_POSITION_HALF) {
+                out->position_origin[k] = lo[k] + extent * 0.5f;
+                out->position_scale[k] = extent * 0.5f;
+            } else {
+                out->position_origin[k] = lo[k];
+                out->position_scale[k] = extent;
+            }
+            inv_scale[k] = out->position_scale[k] > 0.0f ? 1.0f / out->position_scale[k] : 0.0f;
+        }
+    }
+
+    for (size_t v = 0; v < out->vertex_count; v++) {
+        unsigned char *dst = out->data + v * out->stride;
+        if (out->position_offset >= 0) {
+            const float *p = firef_vertex_attribute(obj, v, 0);
+            unsigned char *at = dst + out->position_offset;
+            if (position == OBJ_POSITION_FLOAT) {
+                memcpy(at, p, 3 * sizeof(float));
+            } else {
+                uint16_t packed[4] = { 0, 0, 0, 0 };
+                for (int k = 0; k < 3; k++) {
+                    float t = (p[k] - out->position_origin[k]) * inv_scale[k];
+                    if (position == OBJ_POSITION_HALF) {
+                        packed[k] = firef_float_to_half(firef_clamp_unit(t, -1.0f));
+                    } else {
+                        packed[k] = (uint16_t)(firef_clamp_unit(t, 0.0f) * 65535.0f + 0.5f);
+                    }
+                }
+                memcpy(at, packed, sizeof(packed));
+            }
+        }
+        if (out->uv_offset >= 0) {
+            const float *t = firef_vertex_attribute(obj, v, 1);
+            unsigned char *at = dst + out->uv_offset;
+            if (uv == OBJ_UV_FLOAT) {
+                memcpy(at, t, 2 * sizeof(float));
+            } else {
+                uint16_t packed[2] = { firef_float_to_half(t[0]), firef_float_to_half(t[1]) };
+                memcpy(at, packed, sizeof(packed));
+            }
+        }
+        if (out->normal_offset >= 0) {
+            firef_pack_normal(dst + out->normal_offset, firef_vertex_attribute(obj, v, 2), normal);
+        }
+    }
+    return 0;
+}
+
+void free_packed_vertices(ObjPackedVertices *packed) {
+    FIREF_FREE(packed->data);
+    packed->data = NULL;
+}
+
+// Bounding sphere and normal cone of one finished meshlet.
+static void firef_meshlet_bounds(const Obj *obj, const ObjMeshlets *out, ObjMeshlet *m) {
+    const unsigned int *vertices = out->vertices + m->vertex_offset;
+    const unsigned char *triangles = out->triangles + m->triangle_offset;
+    memset(m->center, 0, sizeof(m->center));
+    memset(m->cone_apex, 0, sizeof(m->cone_apex));
+    memset(m->cone_axis, 0, sizeof(m->cone_axis));
+    m->radius = 0.0f;
+    m->cone_cutoff = 1.0f;
+    if (!(obj->attributes & FIREF_LOAD_POSITIONS)) return;
+
+    float lo[3], hi[3];
+    memcpy(lo, firef_vertex_attribute(obj, vertices[0], 0), sizeof(lo));
+    memcpy(hi, lo, sizeof(hi));
+    for (unsigned int i = 1; i < m->vertex_count; i++) {
+        const float *p = firef_vertex_attribute(obj, vertices[i], 0);
+        for (int k = 0; k < 3; k++) {
+            if (p[k] < lo[k]) lo[k] = p[k];
+            if (p[k] > hi[k]) hi[k] = p[k];
+        }
+    }
+    for (int k = 0; k < 3; k++) m->center[k] = (lo[k] + hi[k]) * 0.5f;
+    for (unsigned int i = 0; i < m->vertex_count; i++) {
+        const float *p = firef_vertex_attribute(obj, vertices[i], 0);
+        float dx = p[0] - m->center[0], dy = p[1] - m->center[1], dz = p[2] - m->center[2];
+        float d = sqrtf(dx * dx + dy * dy + dz * dz);
+        if (d > m->radius) m->radius = d;
+    }
+
+    // Cone around the average face normal. Degenerate triangles have no
+    // orientation and are ignored.
+    float normals[FIREF_MESHLET_TRIANGLE_LIMIT][3];
+    const float *corners[FIREF_MESHLET_TRIANGLE_LIMIT];
+    unsigned int normal_count = 0;
+    float axis[3] = { 0.0f, 0.0f, 0.0f };
+    for (unsigned int t = 0; t < m->triangle_count; t++) {
+        const float *a = firef_vertex_attribute(obj, vertices[triangles[t * 3 + 0]], 0);
+        const float *b = firef_vertex_attribute(obj, vertices[triangles[t * 3 + 1]], 0);
+        const float *c = firef_vertex_attribute(obj, vertices[triangles[t * 3 + 2]], 0);
+        float e1[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+        float e2[3] = { c[0] - a[0], c[1] - a[1], c[2] - a[2] };
+        float n[3] = { e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0] };
+        float length = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+        if (length == 0.0f) continue;
+        for (int k = 0; k < 3; k++) {
+            normals[normal_count][k] = n[k] / length;
+            axis[k] += normals[normal_count][k];
+        }
+        corners[normal_count++] = a;
+    }
+    float axis_length = sqrtf(axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2]);
+    if (normal_count == 0 || axis_length == 0.0f) return;
+    for (int k = 0; k < 3; k++) axis[k] /= axis_length;
+
+    float min_dot = 1.0f;
+    for (unsigned int t = 0; t < normal_count; t++) {
+        float d = normals[t][0] * axis[0] + normals[t][1] * axis[1] + normals[t][2] * axis[2];
+        if (d < min_dot) min_dot = d;
+    }
+    // Spread of 90 degrees or more (or close to it) cannot be culled.
+    if (min_dot <= 0.1f) return;
+    memcpy(m->cone_axis, axis, sizeof(axis));
+
+    // Move the apex back along the axis until it lies behind every
+    // triangle plane, so the test is conservative for any view position.
+    float back = 0.0f;
+    for (unsigned int t = 0; t < normal_count; t++) {
+        const float *n = normals[t];
+        const float *p = corners[t];
+        float dc = (m->center[0] - p[0]) * n[0] + (m->center[1] - p[1]) * n[1] + (m->center[2] - p[2]) * n[2];
+        float dn = axis[0] * n[0] + axis[1] * n[1] + axis[2] * n[2];
+        float distance = dc / dn;
+        if (distance > back) back = distance;
+    }
+    for (int k = 0; k < 3; k++) m->cone_apex[k] = m->center[k] - axis[k] * back;
+    m->cone_cutoff = sqrtf(1.0f - min_dot * min_dot);
+}
+
+int obj_build_meshlets(const Obj *obj, unsigned int max_vertices, unsigned int max_triangles, ObjMeshlets *out) {
+    memset(out, 0, sizeof(*out));
+    if (max_vertices == 0) max_vertices = FIREF_MESHLET_VERTICES;
+    if (max_triangles == 0) max_triangles = FIREF_MESHLET_TRIANGLES;
+    if (max_vertices < 3 || max_vertices > FIREF_MESHLET_VERTEX_LIMIT ||
+        max_triangles > FIREF_MESHLET_TRIANGLE_LIMIT) return -1;
+
+    size_t vertex_total = firef_obj_vertex_total(obj);
+    size_t tri_count = obj->index_count / 3;
+    for (size_t i = 0; i < tri_count * 3; i++) {
+        if (firef_index_at(obj, i) >= vertex_total) return -1;
+    }
+    if (tri_count == 0) return 0;
+
+    // Worst case is one meshlet per triangle.
+    unsigned int *indices = (unsigned int*)FIREF_MALLOC(tri_count * 3 * sizeof(unsigned int));
+    size_t *offsets = (size_t*)FIREF_MALLOC((vertex_total + 1) * sizeof(size_t));
+    unsigned int *adjacency = (unsigned int*)FIREF_MALLOC(tri_count * 3 * sizeof(unsigned int));
+    unsigned char *local = (unsigned char*)FIREF_MALLOC(vertex_total);
+    unsigned char *emitted = (unsigned char*)firef_calloc(tri_count, 1);
+    out->meshlets = (ObjMeshlet*)FIREF_MALLOC(tri_count * sizeof(ObjMeshlet));
+    out->vertices = (unsigned int*)FIREF_MALLOC(tri_count * 3 * sizeof(unsigned int));
+    out->triangles = (unsigned char*)FIREF_MALLOC(tri_count * 3);
+    int status = -1;
+
+    if (indices && offsets && adjacency && local && emitted && out->meshlets && out->vertices && out->triangles) {
+        for (size_t i = 0; i < tri_count * 3; i++) indices[i] = firef_index_at(obj, i);
+        firef_build_vertex_triangles(indices, tri_count * 3, NULL, vertex_total, 0, offsets, adjacency);
+        memset(local, 0xFF, vertex_total);
+
+        ObjMeshlet *m = NULL;
+        size_t cursor = 0, remaining = tri_count;
+        while (remaining > 0) {
+            // Grow the current meshlet with the adjacent triangle that adds
+            // the fewest new vertices; seed a new one in index order.
+            long best = -1;
+            unsigned int best_cost = 4;
+            if (m) {
+                const unsigned int *vertices = out->vertices + m->vertex_offset;
+                for (unsigned int i = 0; i < m->vertex_count && best_cost > 0; i++) {
+                    unsigned int v = vertices[i];
+                    for (size_t k = offsets[v]; k < offsets[v + 1]; k++) {
+                        size_t t = adjacency[k];
+                        if (emitted[t]) continue;
+                        const unsigned int *tri = indices + t * 3;
+                        unsigned int cost = (local[tri[0]] == 0xFF) +
+                            (local[tri[1]] == 0xFF && tri[1] != tri[0]) +
+                            (local[tri[2]] == 0xFF && tri[2] != tri[0] && tri[2] != tri[1]);
+                        if (cost < best_cost) {
+                            best = (long)t;
+                            best_cost = cost;
+                        }
+                    }
+                }
+            }
+            if (best < 0) {
+                while (emitted[cursor]) cursor++;
+                best = (long)cursor;
+                best_cost = 3;
+            }
+
+            if (!m || m->vertex_count + best_cost > max_vertices || m->triangle_count == max_triangles) {
+                if (m) {
+                    for (unsigned int i = 0; i < m->vertex_count; i++) local[out->vertices[m->vertex_offset + i]] = 0xFF;
+                }
+                m = &out->meshlets[out->meshlet_count++];
+                memset(m, 0, sizeof(*m));
+                m->vertex_offset = (unsigned int)out->vertex_count;
+                m->triangle_offset = (unsigned int)out->triangle_count * 3;
+                continue;
+            }
+
+            emitted[best] = 1;
+            remaining--;
+            for (int c = 0; c < 3; c++) {
+                unsigned int v = indices[(size_t)best * 3 + c];
+                if (local[v] == 0xFF) {
+                    local[v] = (unsigned char)m->vertex_count++;
+                    out->vertices[out->vertex_count++] = v;
+                }
+                out->triangles[out->triangle_count * 3 + c] = local[v];
+            }
+            out->triangle_count++;
+            m->triangle_count++;
+        }
+
+        for (size_t i = 0; i < out->meshlet_count; i++) firef_meshlet_bounds(obj, out, &out->meshlets[i]);
+        status = 0;
+    }
+
+    FIREF_FREE(indices);
+    FIREF_FREE(offsets);
+    FIREF_FREE(adjacency);
+    FIREF_FREE(local);
+    FIREF_FREE(emitted);
+    if (status != 0) {
+        free_meshlets(out);
+        return status;
+    }
+
+    void *tmp = FIREF_REALLOC(out->meshlets, out->meshlet_count * sizeof(ObjMeshlet));
+    if (tmp) out->meshlets = (ObjMeshlet*)tmp;
+    tmp = FIREF_REALLOC(out->vertices, out->vertex_count * sizeof(unsigned int));
+    if (tmp) out->vertices = (unsigned int*)tmp;
+    tmp = FIREF_REALLOC(out->triangles, out->triangle_count * 3);
+    if (tmp) out->triangles = (unsigned char*)tmp;
+    return 0;
+}
+
+void free_meshlets(ObjMeshlets *meshlets) {
+    FIREF_FREE(meshlets->meshlets);
+    FIREF_FREE(meshlets->vertices);
+    FIREF_FREE(meshlets->triangles);
+    memset(meshlets, 0, sizeof(*meshlets));
+}
+
+#define FIREF_BVH_BINS 16
+#define FIREF_BVH_MAX_LEAF 16
+#define FIREF_BVH_MAX_DEPTH 60
+
+typedef struct {
+    ObjBvhNode *nodes;
+    size_t len, cap;
+} FirefBvhNodes;
+
+// A subtree below the serially split top levels.
+typedef struct {
+    size_t begin, end;
+    FirefBvhNodes nodes;
+    int depth;
+    int status;
+} FirefBvhTask;
+
+typedef struct {
+    const float *boxes;     // min xyz, max xyz per triangle
+    const float *centroids; // xyz per triangle
+    unsigned int *triangles;
+
+    FirefBvhTask *tasks;
+    int task_count;
+    int worker_count;
+} FirefBvhBuild;
+
+static inline float firef_box_area(const float min[3], const float max[3]) {
+    float dx = max[0] - min[0], dy = max[1] - min[1], dz = max[2] - min[2];
+    return dx * dy + dy * dz + dz * dx;
+}
+
+// Written as selects so they compile to min/max instructions; the
+// branches mispredict constantly on binned data.
+static inline void firef_box_grow(float min[3], float max[3], const float *box) {
+    for (int k = 0; k < 3; k++) {
+        min[k] = box[k] < min[k] ? box[k] : min[k];
+        max[k] = box[k + 3] > max[k] ? box[k + 3] : max[k];
+    }
+}
+
+static long firef_bvh_push(FirefBvhNodes *nodes) {
+    if (firef_reserve(NULL, (void**)&nodes->nodes, &nodes->cap, nodes->len + 1, sizeof(ObjBvhNode)) != 0) return -1;
+    memset(&nodes->nodes[nodes->len], 0, sizeof(ObjBvhNode));
+    return (long)nodes->len++;
+}
+
+// Splits triangles [begin, end) with the cheapest binned SAH plane and
+// returns the first triangle of the right half, or 0 to make a leaf.
+static size_t firef_bvh_split(const FirefBvhBuild *b, size_t begin, size_t end, const ObjBvhNode *node) {
+    size_t count = end - begin;
+    if (count <= 2) return 0;
+
+    float cmin[3] = { FLT_MAX, FLT_MAX, FLT_MAX }, cmax[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+    for (size_t i = begin; i < end; i++) {
+        const float *c = b->centroids + (size_t)b->triangles[i] * 3;
+        for (int k = 0; k < 3; k++) {
+            cmin[k] = c[k] < cmin[k] ? c[k] : cmin[k];
+            cmax[k] = c[k] > cmax[k] ? c[k] : cmax[k];
+        }
+    }
+
+    // Bin every axis in one pass over the triangles.
+    float scale[3];
+    size_t counts[3][FIREF_BVH_BINS];
+    float bins[3][FIREF_BVH_BINS][6];
+    memset(counts, 0, sizeof(counts));
+    for (int axis = 0; axis < 3; axis++) {
+        float extent = cmax[axis] - cmin[axis];
+        scale[axis] = extent > 0.0f ? FIREF_BVH_BINS / extent : 0.0f;
+        for (int i = 0; i < FIREF_BVH_BINS; i++) {
+            bins[axis][i][0] = bins[axis][i][1] = bins[axis][i][2] = FLT_MAX;
+            bins[axis][i][3] = bins[axis][i][4] = bins[axis][i][5] = -FLT_MAX;
+        }
+    }
+    for (size_t i = begin; i < end; i++) {
+        unsigned int t = b->triangles[i];
+        const float *box = b->boxes + (size_t)t * 6;
+        for (int axis = 0; axis < 3; axis++) {
+            int bin = (int)((b->centroids[(size_t)t * 3 + axis] - cmin[axis]) * scale[axis]);
+            bin = bin < FIREF_BVH_BINS ? bin : FIREF_BVH_BINS - 1;
+            counts[axis][bin]++;
+            firef_box_grow(bins[axis][bin], bins[axis][bin] + 3, box);
+        }
+    }
+
+    int best_axis = -1, best_bin = 0;
+    float best_cost = FLT_MAX;
+    for (int axis = 0; axis < 3; axis++) {
+        if (scale[axis] == 0.0f) continue;
+
+        // Sweep from the right, then from the left, to cost every plane.
+        float right_cost[FIREF_BVH_BINS];
+        float min[3] = { FLT_MAX, FLT_MAX, FLT_MAX }, max[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+        size_t n = 0;
+        for (int i = FIREF_BVH_BINS - 1; i > 0; i--) {
+            n += counts[axis][i];
+            firef_box_grow(min, max, bins[axis][i]);
+            right_cost[i] = n ? firef_box_area(min, max) * (float)n : FLT_MAX;
+        }
+        min[0] = min[1] = min[2] = FLT_MAX;
+        max[0] = max[1] = max[2] = -FLT_MAX;
+        n = 0;
+        for (int i = 0; i < FIREF_BVH_BINS - 1; i++) {
+            n += counts[axis][i];
+            firef_box_grow(min, max, bins[axis][i]);
+            if (n == 0 || n == count) continue;
+            float cost = firef_box_area(min, max) * (float)n + right_cost[i + 1];
+            if (cost < best_cost) {
+                best_cost = cost;
+                best_axis = axis;
+                best_bin = i;
+            }
+        }
+    }
+
+    // Traversal is costed like one triangle test.
+    float leaf_cost = firef_box_area(node->min, node->max) * (float)count;
+    float split_cost = firef_box_area(node->min, node->max) + best_cost;
+    if (best_axis < 0) return count > FIREF_BVH_MAX_LEAF ? begin + count / 2 : 0;
+    if (split_cost >= leaf_cost && count <= FIREF_BVH_MAX_LEAF) return 0;
+
+    size_t lo = begin, hi = end;
+    while (lo < hi) {
+        unsigned int t = b->triangles[lo];
+        int bin = (int)((b->centroids[(size_t)t * 3 + best_axis] - cmin[best_axis]) * scale[best_axis]);
+        if (bin >= FIREF_BVH_BINS) bin = FIREF_BVH_BINS - 1;
+        if (bin <= best_bin) {
+            lo++;
+        } else {
+            b->triangles[lo] = b->triangles[--hi];
+            b->triangles[hi] = t;
+        }
+    }
+    return lo;
+}
+
+static void firef_bvh_bounds(const FirefBvhBuild *b, size_t begin, size_t end, ObjBvhNode *node) {
+    node->min[0] = node->min[1] = node->min[2] = FLT_MAX;
+    node->max[0] = node->max[1] = node->max[2] = -FLT_MAX;
+    for (size_t i = begin; i < end; i++) firef_box_grow(node->min, node->max, b->boxes + (size_t)b->triangles[i] * 6);
+}
+
+// Builds the subtree over [begin, end) depth first into nodes.
+static int firef_bvh_build_node(const FirefBvhBuild *b, FirefBvhNodes *nodes, size_t begin, size_t end, int depth) {
+    long index = firef_bvh_push(nodes);
+    if (index < 0) return -1;
+    ObjBvhNode node;
+    firef_bvh_bounds(b, begin, end, &node);
+    size_t mid = depth < FIREF_BVH_MAX_DEPTH ? firef_bvh_split(b, begin, end, &node) : 0;
+    if (mid == 0) {
+        node.first = (unsigned int)begin;
+        node.count = (unsigned int)(end - begin);
+        nodes->nodes[index] = node;
+        return 0;
+    }
+    node.count = 0;
+    if (firef_bvh_build_node(b, nodes, begin, mid, depth + 1) != 0) return -1;
+    node.first = (unsigned int)nodes->len;
+    nodes->nodes[index] = node;
+    return firef_bvh_build_node(b, nodes, mid, end, depth + 1);
+}
+
+static void firef_bvh_worker(void *ctx, int index) {
+    FirefBvhBuild *b = (FirefBvhBuild*)ctx;
+    for (int i = index; i < b->task_count; i += b->worker_count) {
+        FirefBvhTask *task = &b->tasks[i];
+        task->status = firef_bvh_build_node(b, &task->nodes, task->begin, task->end, task->depth);
+    }
+}
+
+// Splits the top levels serially. Subtrees at split_depth become tasks,
+// marked in the top tree by a count of UINT_MAX and the task number.
+static int firef_bvh_build_top(FirefBvhBuild *b, FirefBvhNodes *top, size_t begin, size_t end, int depth, int split_depth) {
+    long index = firef_bvh_push(top);
+    if (index < 0) return -1;
+    ObjBvhNode node;
+    firef_bvh_bounds(b, begin, end, &node);
+    size_t mid = 0;
+    if (depth == split_depth || (mid = firef_bvh_split(b, begin, end, &node)) == 0) {
+        FirefBvhTask *task = &b->tasks[b->task_count];
+        task->begin = begin;
+        task->end = end;
+        task->depth = depth;
+        node.first = (unsigned int)b->task_count++;
+        node.count = UINT_MAX;
+        top->nodes[index] = node;
+        return 0;
+    }
+    node.count = 0;
+    if (firef_bvh_build_top(b, top, begin, mid, depth + 1, split_depth) != 0) return -1;
+    node.first = (unsigned int)top->len;
+    top->nodes[index] = node;
+    return firef_bvh_build_top(b, top, mid, end, depth + 1, split_depth);
+}
+
+// Copies the top tree into out depth first, splicing in the task subtrees.
+static int firef_bvh_emit(FirefBvhNodes *out, const FirefBvhNodes *top, size_t index, const FirefBvhTask *tasks) {
+    ObjBvhNode node = top->nodes[index];
+    if (node.count == UINT_MAX) {
+        const FirefBvhNodes *sub = &tasks[node.first].nodes;
+        size_t base = out->len;
+        if (firef_reserve(NULL, (void**)&out->nodes, &out->cap, base + sub->len, sizeof(ObjBvhNode)) != 0) return -1;
+        for (size_t i = 0; i < sub->len; i++) {
+            ObjBvhNode n = sub->nodes[i];
+            if (n.count == 0) n.first += (unsigned int)base;
+            out->nodes[base + i] = n;
+        }
+        out->len += sub->len;
+        return 0;
+    }
+    long at = firef_bvh_push(out);
+    if (at < 0) return -1;
+    out->nodes[at] = node;
+    if (firef_bvh_emit(out, top, index + 1, tasks) != 0) return -1;
+    out->nodes[at].first = (unsigned int)out->len;
+    return firef_bvh_emit(out, top, node.first, tasks);
+}
+
+int obj_build_bvh(const Obj *obj, int threads, ObjBvh *out) {
+    memset(out, 0, sizeof(*out));
+    size_t vertex_total = firef_obj_vertex_total(obj);
+    size_t tri_count = obj->index_count / 3;
+    if (!(obj->attributes & FIREF_LOAD_POSITIONS)) return -1;
+    for (size_t i = 0; i < tri_count * 3; i++) {
+        if (firef_index_at(obj, i) >= vertex_total) return -1;
+    }
+    if (tri_count == 0) return 0;
+
+    int workers = threads > 1 ? threads : 1;
+    int split_depth = 0;
+    while ((1 << split_depth) < workers * 4 && split_depth < 10) split_depth++;
+    if (workers == 1) split_depth = 0;
+
+    FirefBvhBuild b;
+    memset(&b, 0, sizeof(b));
+    float *boxes = (float*)FIREF_MALLOC(tri_count * 6 * sizeof(float));
+    float *centroids = (float*)FIREF_MALLOC(tri_count * 3 * sizeof(float));
+    b.triangles = (unsigned int*)FIREF_MALLOC(tri_count * sizeof(unsigned int));
+    b.tasks = (FirefBvhTask*)firef_calloc((size_t)1 << split_depth, sizeof(FirefBvhTask));
+    b.boxes = boxes;
+    b.centroids = centroids;
+    b.worker_count = workers;
+    FirefBvhNodes top = { NULL, 0, 0 }, nodes = { NULL, 0, 0 };
+    out->positions = (float*)FIREF_MALLOC(tri_count * 9 * sizeof(float));
+    int status = -1;
+
+    if (boxes && centroids && b.triangles && b.tasks && out->positions) {
+        for (size_t t = 0; t < tri_count; t++) {
+            float *box = boxes + t * 6;
+            box[0] = box[1] = box[2] = FLT_MAX;
+            box[3] = box[4] = box[5] = -FLT_MAX;
+            for (int c = 0; c < 3; c++) {
+                const float *p = firef_vertex_attribute(obj, firef_index_at(obj, t * 3 + c), 0);
+                for (int k = 0; k < 3; k++) {
+                    if (p[k] < box[k]) box[k] = p[k];
+                    if (p[k] > box[k + 3]) box[k + 3] = p[k];
+                }
+            }
+            for (int k = 0; k < 3; k++) centroids[t * 3 + k] = (box[k] + box[k + 3]) * 0.5f;
+            b.triangles[t] = (unsigned int)t;
+        }
+
+        status = firef_bvh_build_top(&b, &top, 0, tri_count, 0, split_depth);
+        if (status == 0) {
+            firef_parallel_for(NULL, b.task_count < workers ? b.task_count : workers, firef_bvh_worker, &b);
+            for (int i = 0; i < b.task_count; i++) {
+                if (b.tasks[i].status != 0) status = -1;
+            }
+        }
+        if (status == 0) status = firef_bvh_emit(&nodes, &top, 0, b.tasks);
+        if (status == 0) {
+            for (size_t i = 0; i < tri_count; i++) {
+                for (int c = 0; c < 3; c++) {
+                    const float *p = firef_vertex_attribute(obj, firef_index_at(obj, (size_t)b.triangles[i] * 3 + c), 0);
+                    memcpy(out->positions + i * 9 + c * 3, p, 3 * sizeof(float));
+                }
+            }
+        }
+    }
+
+    if (b.tasks) {
+        for (int i = 0; i < b.task_count; i++) FIREF_FREE(b.tasks[i].nodes.nodes);
+    }
+    FIREF_FREE(b.tasks);
+    FIREF_FREE(top.nodes);
+    FIREF_FREE(boxes);
+    FIREF_FREE(centroids);
+    out->triangles = b.triangles;
+    out->nodes = nodes.nodes;
+    out->node_count = nodes.len;
+    out->triangle_count = tri_count;
+    if (status != 0) {
+        free_bvh(out);
+        return -1;
+    }
+    return 0;
+}
+
+void free_bvh(ObjBvh *bvh) {
+    FIREF_FREE(bvh->nodes);
+    FIREF_FREE(bvh->triangles);
+    FIREF_FREE(bvh->positions);
+    memset(bvh, 0, sizeof(*bvh));
+}
+
+// Slab test; returns the entry distance or FLT_MAX on a miss. An axis the
+// ray does not move along (infinite inv_dir) only checks that the origin lies
+// within the closed slab: on a face plane the slab distances would be
+// 0 * inf = NaN.
+static inline float firef_ray_box(const ObjBvhNode *node, const float origin[3], const float inv_dir[3], float t_max) {
+    float t0 = 0.0f, t1 = t_max;
+    for (int k = 0; k < 3; k++) {
+        if (fabsf(inv_dir[k]) > FLT_MAX) {
+            if (origin[k] < node->min[k] || origin[k] > node->max[k]) return FLT_MAX;
+            continue;
+        }
+        float a = (node->min[k] - origin[k]) * inv_dir[k];
+        float b = (node->max[k] - origin[k]) * inv_dir[k];
+        if (a > b) {
+            float tmp = a;
+            a = b;
+            b = tmp;
+        }
+        if (a > t0) t0 = a;
+        if (b < t1) t1 = b;
+    }
+    return t0 <= t1 ? t0 : FLT_MAX;
+}
+
+// Moller-Trumbore against the triangle with corners p[0..8].
+static inline int firef_ray_triangle(const float *p, const float origin[3], const float dir[3], float t_max, ObjRayHit *hit) {
+    float e1[3] = { p[3] - p[0], p[4] - p[1], p[5] - p[2] };
+    float e2[3] = { p[6] - p[0], p[7] - p[1], p[8] - p[2] };
+    float pv[3] = { dir[1] * e2[2] - dir[2] * e2[1], dir[2] * e2[0] - dir[0] * e2[2], dir[0] * e2[1] - dir[1] * e2[0] };
+    float det = e1[0] * pv[0] + e1[1] * pv[1] + e1[2] * pv[2];
+    if (det == 0.0f) return 0;
+    float inv_det = 1.0f / det;
+    float tv[3] = { origin[0] - p[0], origin[1] - p[1], origin[2] - p[2] };
+    float u = (tv[0] * pv[0] + tv[1] * pv[1] + tv[2] * pv[2]) * inv_det;
+    if (u < 0.0f || u > 1.0f) return 0;
+    float qv[3] = { tv[1] * e1[2] - tv[2] * e1[1], tv[2] * e1[0] - tv[0] * e1[2], tv[0] * e1[1] - tv[1] * e1[0] };
+    float v = (dir[0] * qv[0] + dir[1] * qv[1] + dir[2] * qv[2]) * inv_det;
+    if (v < 0.0f || u + v > 1.0f) return 0;
+    float t = (e2[0] * qv[0] + e2[1] * qv[1] + e2[2] * qv[2]) * inv_det;
+    if (t < 0.0f || t > t_max) return 0;
+    hit->t = t;
+    hit->u = u;
+    hit->v = v;
+    return 1;
+}
+
+static int firef_bvh_trace(const ObjBvh *bvh, const float origin[3], const float dir[3], float t_max, ObjRayHit *hit, int any) {
+    if (bvh->node_count == 0) return 0;
+    float inv_dir[3];
+    for (int k = 0; k < 3; k++) inv_dir[k] = 1.0f / dir[k];
+
+    unsigned int stack[FIREF_BVH_MAX_DEPTH + 2];
+    int top = 0;
+    int found = 0;
+    unsigned int index = 0;
+    if (firef_ray_box(&bvh->nodes[0], origin, inv_dir, t_max) == FLT_MAX) return 0;
+    for (;;) {
+        const ObjBvhNode *node = &bvh->nodes[index];
+        if (node->count > 0) {
+            for (unsigned int i = node->first; i < node->first + node->count; i++) {
+                ObjRayHit candidate;
+                if (!firef_ray_triangle(bvh->positions + (size_t)i * 9, origin, dir, t_max, &candidate)) continue;
+                candidate.triangle = bvh->triangles[i];
+                *hit = candidate;
+                t_max = candidate.t;
+                found = 1;
+                if (any) return 1;
+            }
+        } else {
+            // Visit the nearer child first and keep the other for later.
+            unsigned int left = index + 1, right = node->first;
+            float t_left = firef_ray_box(&bvh->nodes[left], origin, inv_dir, t_max);
+            float t_right = firef_ray_box(&bvh->nodes[right], origin, inv_dir, t_max);
+            if (t_left != FLT_MAX && t_right != FLT_MAX) {
+                if (t_right < t_left) {
+                    unsigned int tmp = left;
+                    left = right;
+                    right = tmp;
+                }
+                stack[top++] = right;
+                index = left;
+                continue;
+            }
+            if (t_left != FLT_MAX) {
+                index = left;
+                continue;
+            }
+            if (t_right != FLT_MAX) {
+                index = right;
+                continue;
+            }
+        }
+        if (top == 0) break;
+        index = stack[--top];
+    }
+    return found;
+}
+
+int obj_bvh_intersect(const ObjBvh *bvh, const float origin[3], const float dir[3], float t_max, ObjRayHit *hit) {
+    return firef_bvh_trace(bvh, origin, dir, t_max, hit, 0);
+}
+
+int obj_bvh_occluded(const ObjBvh *bvh, const float origin[3], const float dir[3], float t_max) {
+    ObjRayHit hit;
+    return firef_bvh_trace(bvh, origin, dir, t_max, &hit, 1);
+}
+
+typedef struct {
+    const unsigned int *indices;
+    const unsigned int *weld;    // vertex -> welded position
+    const size_t *offsets;       // welded position -> range of corners
+    const unsigned int *corners; // corners (triangle * 3 + corner) by position
+    const float *face_normals;   // unit normal per triangle, 0 if degenerate
+    const float *weights;        // weight per corner
+    float *normals;              // per position when smoothing all, else per corner
+    float cos_angle;
+    int smooth_all;
+    size_t count;
+    int task_count;
+} FirefNormalJob;
+
+// Gathers the weighted face normals around each position (or corner) in a
+// range, so every output is written by exactly one task.
+static void firef_normal_task(void *ctx, int index) {
+    FirefNormalJob *job = (FirefNormalJob*)ctx;
+    size_t begin = job->count * (size_t)index / (size_t)job->task_count;
+    size_t end = job->count * (size_t)(index + 1) / (size_t)job->task_count;
+    for (size_t i = begin; i < end; i++) {
+        const float *own = NULL;
+        size_t p = i;
+        if (!job->smooth_all) {
+            own = job->face_normals + i / 3 * 3;
+            p = job->weld[job->indices[i]];
+            if (own[0] == 0.0f && own[1] == 0.0f && own[2] == 0.0f) own = NULL;
+        }
+        float sum[3] = { 0.0f, 0.0f, 0.0f };
+        for (size_t k = job->offsets[p]; k < job->offsets[p + 1]; k++) {
+            unsigned int corner = job->corners[k];
+            const float *n = job->face_normals + corner / 3 * 3;
+            if (own && own[0] * n[0] + own[1] * n[1] + own[2] * n[2] < job->cos_angle) continue;
+            float w = job->weights[corner];
+            sum[0] += n[0] * w;
+            sum[1] += n[1] * w;
+            sum[2] += n[2] * w;
+        }
+        float length = sqrtf(sum[0] * sum[0] + sum[1] * sum[1] + sum[2] * sum[2]);
+        float *out = job->normals + i * 3;
+        if (length > 0.0f) {
+            for (int k = 0; k < 3; k++) out[k] = sum[k] / length;
+        } else if (own) {
+            memcpy(out, own, 3 * sizeof(float));
+        } else {
+            memset(out, 0, 3 * sizeof(float));
+        }
+    }
+}
+
+// Numbers the distinct vertices of obj, comparing only the attributes in
+// mask; -0 and 0 weld together.
+static size_t firef_weld_vertices(ObjArena *scratch, const Obj *obj, size_t vertex_total, unsigned int mask, unsigned int *weld) {
+    size_t cap = 16;
+    while (cap < vertex_total * 2) cap *= 2;
+    unsigned int *table = (unsigned int*)firef_alloc(scratch, cap * sizeof(unsigned int));
+    if (!table) return (size_t)-1;
+    memset(table, 0xFF, cap * sizeof(unsigned int));
+
+    size_t count = 0;
+    for (size_t v = 0; v < vertex_total; v++) {
+        float key[16], other_key[16];
+        size_t len = 0;
+        for (int a = 0; a < FIREF_ATTRIBUTE_COUNT; a++) {
+            if (!(mask & firef_attribute_bits[a])) continue;
+            const float *value = firef_vertex_attribute(obj, v, a);
+            for (unsigned int k = 0; k < firef_attribute_sizes[a]; k++) key[len++] = value[k] + 0.0f;
+        }
+        size_t slot = (size_t)firef_hash_bytes((const char*)key, len * sizeof(float)) & (cap - 1);
+        for (;;) {
+            unsigned int other = table[slot];
+            if (other == UINT_MAX) {
+                table[slot] = (unsigned int)v;
+                weld[v] = (unsigned int)count++;
+                break;
+            }
+            size_t other_len = 0;
+            for (int a = 0; a < FIREF_ATTRIBUTE_COUNT; a++) {
+                if (!(mask & firef_attribute_bits[a])) continue;
+                const float *value = firef_vertex_attribute(obj, other, a);
+                for (unsigned int k = 0; k < firef_attribute_sizes[a]; k++) other_key[other_len++] = value[k] + 0.0f;
+            }
+            if (memcmp(key, other_key, len * sizeof(float)) == 0) {
+                weld[v] = weld[other];
+                break;
+            }
+            slot = (slot + 1) & (cap - 1);
+        }
+    }
+    firef_free(scratch, table);
+    return count;
+}
+
+// Gives each of the corner_total triangle corners its own value of
+// attribute, reusing a vertex for corners whose values are identical and
+// cloning it for the others.
+static int firef_split_vertices(ObjArena *scratch, Obj *obj, int attribute, const unsigned int *indices, const float *corner_values, size_t corner_total, size_t vertex_total) {
+    size_t components = firef_attribute_sizes[attribute];
+    size_t cap = vertex_total + corner_total;
+    unsigned int *source = (unsigned int*)firef_alloc(scratch, (cap ? cap : 1) * sizeof(unsigned int));
+    unsigned int *next = (unsigned int*)firef_alloc(scratch, (cap ? cap : 1) * sizeof(unsigned int));
+    const float **value_of = (const float**)firef_alloc(scratch, (cap ? cap : 1) * sizeof(float*));
+    unsigned int *remapped = (unsigned int*)firef_alloc(scratch, (corner_total ? corner_total : 1) * sizeof(unsigned int));
+    int status = -1;
+
+    if (source && next && value_of && remapped) {
+        memset(value_of, 0, (cap ? cap : 1) * sizeof(float*));
+        size_t total = vertex_total;
+        for (size_t v = 0; v < vertex_total; v++) {
+            source[v] = (unsigned int)v;
+            next[v] = UINT_MAX;
+        }
+        for (size_t i = 0; i < corner_total; i++) {
+            const float *n = corner_values + i * components;
+            unsigned int v = indices[i], last = v;
+            while (v != UINT_MAX && value_of[v] && memcmp(value_of[v], n, components * sizeof(float)) != 0) {
+                last = v;
+                v = next[v];
+            }
+            if (v == UINT_MAX) {
+                v = (unsigned int)total++;
+                source[v] = source[last];
+                next[v] = UINT_MAX;
+                next[last] = v;
+            }
+            value_of[v] = n;
+            remapped[i] = v;
+        }
+
+        status = 0;
+        if (total > UINT_MAX) status = -1;
+        if (status == 0 && total > vertex_total) {
+            Obj grown = *obj;
+            status = firef_alloc_vertices(&grown, total);
+            for (size_t v = 0; status == 0 && v < total; v++) {
+                for (int a = 0; a < FIREF_ATTRIBUTE_COUNT; a++) {
+                    if (!(obj->attributes & firef_attribute_bits[a])) continue;
+                    memcpy((float*)firef_vertex_attribute(&grown, v, a), firef_vertex_attribute(obj, source[v], a),
+                           firef_attribute_sizes[a] * sizeof(float));
+                }
+            }
+            if (status == 0) {
+                firef_replace_vertices(obj, &grown);
+                obj->vertex_count = total * obj->stride;
+            }
+        }
+        if (status == 0 && obj->index_size == 2 && total > 65536) {
+            unsigned int *wide = (unsigned int*)firef_alloc(obj->arena, (obj->index_count ? obj->index_count : 1) * sizeof(unsigned int));
+            if (!wide) {
+                status = -1;
+            } else {
+                // Corners past the last triangle keep their vertex.
+                for (size_t i = corner_total; i < obj->index_count; i++) wide[i] = obj->indices16[i];
+                firef_free(obj->arena, obj->indices16);
+                obj->indices16 = NULL;
+                obj->indices = wide;
+                obj->index_size = 4;
+            }
+        }
+        if (status == 0) {
+            for (size_t v = 0; v < total; v++) {
+                if (value_of[v]) memcpy((float*)firef_vertex_attribute(obj, v, attribute), value_of[v], components * sizeof(float));
+            }
+            for (size_t i = 0; i < corner_total; i++) firef_set_index(obj, i, remapped[i]);
+        }
+    }
+
+    firef_free(scratch, source);
+    firef_free(scratch, next);
+    firef_free(scratch, value_of);
+    firef_free(scratch, remapped);
+    return status;
+}
+
+// Temporaries come from scratch, or the heap when it is NULL.
+static int firef_generate_normals(ObjArena *scratch, Obj *obj, float smoothing_angle, ObjNormalWeighting weighting, int threads) {
+    const unsigned int needed = FIREF_LOAD_POSITIONS | FIREF_LOAD_NORMALS;
+    if ((obj->attributes & needed) != needed) return -1;
+    size_t vertex_total = firef_obj_vertex_total(obj);
+    size_t tri_count = obj->index_count / 3;
+    size_t corner_total = tri_count * 3;
+    for (size_t i = 0; i < corner_total; i++) {
+        if (firef_index_at(obj, i) >= vertex_total) return -1;
+    }
+    if (vertex_total == 0) return 0;
+
+    FirefNormalJob job;
+    memset(&job, 0, sizeof(job));
+    job.smooth_all = smoothing_angle <= 0.0f || smoothing_angle >= 180.0f;
+    job.cos_angle = job.smooth_all ? -1.0f : cosf(smoothing_angle * 3.14159265358979f / 180.0f);
+
+    unsigned int *indices = (unsigned int*)firef_alloc(scratch, (corner_total ? corner_total : 1) * sizeof(unsigned int));
+    unsigned int *weld = (unsigned int*)firef_alloc(scratch, vertex_total * sizeof(unsigned int));
+    float *face_normals = (float*)firef_alloc(scratch, (tri_count ? tri_count : 1) * 3 * sizeof(float));
+    float *weights = (float*)firef_alloc(scratch, (corner_total ? corner_total : 1) * sizeof(float));
+    unsigned int *corners = (unsigned int*)firef_alloc(scratch, (corner_total ? corner_total : 1) * sizeof(unsigned int));
+    size_t *offsets = NULL;
+    float *normals = NULL;
+    int status = -1;
+
+    size_t position_total = 0;
+    if (indices && weld && face_normals && weights && corners) {
+        position_total = firef_weld_vertices(scratch, obj, vertex_total, FIREF_LOAD_POSITIONS, weld);
+        offsets = position_total != (size_t)-1 ? (size_t*)firef_alloc(scratch, (position_total + 1) * sizeof(size_t)) : NULL;
+        normals = (float*)firef_alloc(scratch, (job.smooth_all ? position_total : corner_total) * 3 * sizeof(float) + 1);
+    }
+
+    if (offsets && normals) {
+        for (size_t i = 0; i < corner_total; i++) indices[i] = firef_index_at(obj, i);
+        for (size_t t = 0; t < tri_count; t++) {
+            const float *p[3];
+            for (int c = 0; c < 3; c++) p[c] = firef_vertex_attribute(obj, indices[t * 3 + c], 0);
+            float e1[3] = { p[1][0] - p[0][0], p[1][1] - p[0][1], p[1][2] - p[0][2] };
+            float e2[3] = { p[2][0] - p[0][0], p[2][1] - p[0][1], p[2][2] - p[0][2] };
+            float n[3] = { e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0] };
+            float length = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+            float inv = length > 0.0f ? 1.0f / length : 0.0f;
+            for (int k = 0; k < 3; k++) face_normals[t * 3 + k] = n[k] * inv;
+
+            for (int c = 0; c < 3; c++) {
+                if (weighting == OBJ_NORMALS_AREA_WEIGHTED || length == 0.0f) {
+                    weights[t * 3 + c] = length;
+                    continue;
+                }
+                // Angle between the two edges leaving this corner.
+                const float *a = p[c], *b = p[(c + 1) % 3], *d = p[(c + 2) % 3];
+                float u[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+                float w[3] = { d[0] - a[0], d[1] - a[1], d[2] - a[2] };
+                float lu = sqrtf(u[0] * u[0] + u[1] * u[1] + u[2] * u[2]);
+                float lw = sqrtf(w[0] * w[0] + w[1] * w[1] + w[2] * w[2]);
+                float cosine = lu > 0.0f && lw > 0.0f ? (u[0] * w[0] + u[1] * w[1] + u[2] * w[2]) / (lu * lw) : 1.0f;
+                weights[t * 3 + c] = acosf(cosine < -1.0f ? -1.0f : cosine > 1.0f ? 1.0f : cosine);
+            }
+        }
+
+        firef_build_vertex_triangles(indices, corner_total, weld, position_total, 1, offsets, corners);
+
+        job.indices = indices;
+        job.weld = weld;
+        job.offsets = offsets;
+        job.corners = corners;
+        job.face_normals = face_normals;
+        job.weights = weights;
+        job.normals = normals;
+        job.count = job.smooth_all ? position_total : corner_total;
+        job.task_count = threads > 1 ? threads : 1;
+        if ((size_t)job.task_count > job.count) job.task_count = job.count ? (int)job.count : 1;
+        firef_parallel_for(scratch, job.task_count, firef_normal_task, &job);
+
+        if (job.smooth_all) {
+            // One normal per welded position: vertices keep their indices.
+            for (size_t v = 0; v < vertex_total; v++) {
+                memcpy((float*)firef_vertex_attribute(obj, v, 2), normals + (size_t)weld[v] * 3, 3 * sizeof(float));
+            }
+            status = 0;
+        } else {
+            status = firef_split_vertices(scratch, obj, 2, indices, normals, corner_total, vertex_total);
+        }
+    }
+
+    firef_free(scratch, indices);
+    firef_free(scratch, weld);
+    firef_free(scratch, face_normals);
+    firef_free(scratch, weights);
+    firef_free(scratch, corners);
+    firef_free(scratch, offsets);
+    firef_free(scratch, normals);
+    return status;
+}
+
+int obj_generate_normals(Obj *obj, float smoothing_angle, ObjNormalWeighting weighting, int threads) {
+    return firef_generate_normals(NULL, obj, smoothing_angle, weighting, threads);
+}
+
+typedef struct {
+    const Obj *obj;
+    const unsigned int *indices;
+    const unsigned int *weld;    // vertex -> welded position/uv/normal
+    const size_t *offsets;       // welded vertex -> range of corners
+    const unsigned int *corners; // corners by welded vertex
+    float *projected;            // per corner: unit tangent in the normal's plane
+    float *weights;              // per corner: angle, 0 if degenerate
+    unsigned char *preserving;   // per triangle: uv winding matches the geometry
+    float *tangents;             // per corner output, 4 floats
+    size_t tri_count;
+    int task_count;
+} FirefTangentJob;
+
+static inline void firef_normalize(float v[3]) {
+    float length = sqrtf(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+    float inv = length > 0.0f ? 1.0f / length : 0.0f;
+    v[0] *= inv;
+    v[1] *= inv;
+    v[2] *= inv;
+}
+
+static inline void firef_project(float v[3], const float n[3]) {
+    float d = v[0] * n[0] + v[1] * n[1] + v[2] * n[2];
+    for (int k = 0; k < 3; k++) v[k] -= n[k] * d;
+    firef_normalize(v);
+}
+
+// Per-triangle part: the uv gradient of each triangle
+// projected onto the normal plane of each of its corners, weighted by the
+// corner angle in that plane.
+static void firef_tangent_triangles(void *ctx, int index) {
+    FirefTangentJob *job = (FirefTangentJob*)ctx;
+    size_t begin = job->tri_count * (size_t)index / (size_t)job->task_count;
+    size_t end = job->tri_count * (size_t)(index + 1) / (size_t)job->task_count;
+    for (size_t t = begin; t < end; t++) {
+        const float *p[3], *uv[3];
+        float n[3][3];
+        for (int c = 0; c < 3; c++) {
+            unsigned int v = job->indices[t * 3 + c];
+            p[c] = firef_vertex_attribute(job->obj, v, 0);
+            uv[c] = firef_vertex_attribute(job->obj, v, 1);
+            memcpy(n[c], firef_vertex_attribute(job->obj, v, 2), sizeof(n[c]));
+            firef_normalize(n[c]);
+        }
+        float e1[3] = { p[1][0] - p[0][0], p[1][1] - p[0][1], p[1][2] - p[0][2] };
+        float e2[3] = { p[2][0] - p[0][0], p[2][1] - p[0][1], p[2][2] - p[0][2] };
+        float du1 = uv[1][0] - uv[0][0], dv1 = uv[1][1] - uv[0][1];
+        float du2 = uv[2][0] - uv[0][0], dv2 = uv[2][1] - uv[0][1];
+        float area = du1 * dv2 - du2 * dv1;
+        float sign = area > 0.0f ? 1.0f : -1.0f;
+        float s[3];
+        for (int k = 0; k < 3; k++) s[k] = (dv2 * e1[k] - dv1 * e2[k]) * sign;
+        float s_length = sqrtf(s[0] * s[0] + s[1] * s[1] + s[2] * s[2]);
+        int degenerate = area == 0.0f || s_length == 0.0f;
+        job->preserving[t] = area > 0.0f;
+
+        for (int c = 0; c < 3; c++) {
+            float *out = job->projected + (t * 3 + c) * 3;
+            memcpy(out, s, sizeof(s));
+            firef_project(out, n[c]);
+            const float *a = p[c], *b = p[(c + 1) % 3], *d = p[(c + 2) % 3];
+            float u[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+            float w[3] = { d[0] - a[0], d[1] - a[1], d[2] - a[2] };
+            firef_project(u, n[c]);
+            firef_project(w, n[c]);
+            float cosine = u[0] * w[0] + u[1] * w[1] + u[2] * w[2];
+            float angle = acosf(cosine < -1.0f ? -1.0f : cosine > 1.0f ? 1.0f : cosine);
+            job->weights[t * 3 + c] = degenerate ? 0.0f : angle;
+        }
+    }
+}
+
+// Per-corner part: sums the corners on the same welded vertex with the
+// same uv winding, so mirrored uv islands keep separate tangents.
+static void firef_tangent_corners(void *ctx, int index) {
+    FirefTangentJob *job = (FirefTangentJob*)ctx;
+    size_t corner_total = job->tri_count * 3;
+    size_t begin = corner_total * (size_t)index / (size_t)job->task_count;
+    size_t end = corner_total * (size_t)(index + 1) / (size_t)job->task_count;
+    for (size_t i = begin; i < end; i++) {
+        unsigned int w = job->weld[job->indices[i]];
+        unsigned char preserving = job->preserving[i / 3];
+        float sum[3] = { 0.0f, 0.0f, 0.0f };
+        for (size_t k = job->offsets[w]; k < job->offsets[w + 1]; k++) {
+            unsigned int corner = job->corners[k];
+            if (job->preserving[corner / 3] != preserving) continue;
+            const float *t = job->projected + (size_t)corner * 3;
+            float weight = job->weights[corner];
+            sum[0] += t[0] * weight;
+            sum[1] += t[1] * weight;
+            sum[2] += t[2] * weight;
+        }
+        float n[3];
+        memcpy(n, firef_vertex_attribute(job->obj, job->indices[i], 2), sizeof(n));
+        firef_normalize(n);
+        firef_project(sum, n);
+        if (sum[0] == 0.0f && sum[1] == 0.0f && sum[2] == 0.0f) {
+            // No usable uv gradient: any unit vector in the normal's plane.
+            float axis[3] = { fabsf(n[0]) < 0.9f ? 1.0f : 0.0f, fabsf(n[0]) < 0.9f ? 0.0f : 1.0f, 0.0f };
+            memcpy(sum, axis, sizeof(sum));
+            firef_project(sum, n);
+        }
+        float *out = job->tangents + i * 4;
+        memcpy(out, sum, sizeof(sum));
+        out[3] = preserving ? 1.0f : -1.0f;
+    }
+}
+
+// Adds the tangent slot to the vertices of obj, zero filled.
+static int firef_add_tangents(Obj *obj) {
+    size_t vertex_total = firef_obj_vertex_total(obj);
+    Obj grown = *obj;
+    grown.attributes |= FIREF_LOAD_TANGENTS;
+    grown.stride = firef_attribute_stride(grown.attributes);
+    if (firef_alloc_vertices(&grown, vertex_total) != 0) return -1;
+    for (size_t v = 0; v < vertex_total; v++) {
+        for (int a = 0; a < FIREF_ATTRIBUTE_COUNT; a++) {
+            if (!(grown.attributes & firef_attribute_bits[a])) continue;
+            float *to = (float*)firef_vertex_attribute(&grown, v, a);
+            if (obj->attributes & firef_attribute_bits[a]) {
+                memcpy(to, firef_vertex_attribute(obj, v, a), firef_attribute_sizes[a] * sizeof(float));
+            } else {
+                memset(to, 0, firef_attribute_sizes[a] * sizeof(float));
+            }
+        }
+    }
+    firef_replace_vertices(obj, &grown);
+    obj->attributes = grown.attributes;
+    obj->stride = grown.stride;
+    obj->vertex_count = vertex_total * grown.stride;
+    return 0;
+}
+
+// Temporaries come from scratch, or the heap when it is NULL.
+static int firef_generate_tangents(ObjArena *scratch, Obj *obj, int threads) {
+    const unsigned int needed = FIREF_LOAD_POSITIONS | FIREF_LOAD_UVS | FIREF_LOAD_NORMALS;
+    if ((obj->attributes & needed) != needed) return -1;
+    size_t vertex_total = firef_obj_vertex_total(obj);
+    size_t tri_count = obj->index_count / 3;
+    size_t corner_total = tri_count * 3;
+    for (size_t i = 0; i < corner_total; i++) {
+        if (firef_index_at(obj, i) >= vertex_total) return -1;
+    }
+    if (!(obj->attributes & FIREF_LOAD_TANGENTS) && firef_add_tangents(obj) != 0) return -1;
+    if (corner_total == 0) return 0;
+
+    FirefTangentJob job;
+    memset(&job, 0, sizeof(job));
+    unsigned int *indices = (unsigned int*)firef_alloc(scratch, corner_total * sizeof(unsigned int));
+    unsigned int *weld = (unsigned int*)firef_alloc(scratch, vertex_total * sizeof(unsigned int));
+    unsigned int *corners = (unsigned int*)firef_alloc(scratch, corner_total * sizeof(unsigned int));
+    float *projected = (float*)firef_alloc(scratch, corner_total * 3 * sizeof(float));
+    float *weights = (float*)firef_alloc(scratch, corner_total * sizeof(float));
+    unsigned char *preserving = (unsigned char*)firef_alloc(scratch, tri_count);
+    float *tangents = (float*)firef_alloc(scratch, corner_total * 4 * sizeof(float));
+    size_t *offsets = NULL;
+    int status = -1;
+
+    size_t weld_total = (size_t)-1;
+    if (indices && weld && corners && projected && weights && preserving && tangents) {
+        weld_total = firef_weld_vertices(scratch, obj, vertex_total, needed, weld);
+        if (weld_total != (size_t)-1) offsets = (size_t*)firef_alloc(scratch, (weld_total + 1) * sizeof(size_t));
+    }
+
+    if (offsets) {
+        for (size_t i = 0; i < corner_total; i++) indices[i] = firef_index_at(obj, i);
+        firef_build_vertex_triangles(indices, corner_total, weld, weld_total, 1, offsets, corners);
+
+        job.obj = obj;
+        job.indices = indices;
+        job.weld = weld;
+        job.offsets = offsets;
+        job.corners = corners;
+        job.projected = projected;
+        job.weights = weights;
+        job.preserving = preserving;
+        job.tangents = tangents;
+        job.tri_count = tri_count;
+        job.task_count = threads > 1 ? threads : 1;
+        if ((size_t)job.task_count > tri_count) job.task_count = (int)tri_count;
+        firef_parallel_for(scratch, job.task_count, firef_tangent_triangles, &job);
+        firef_parallel_for(scratch, job.task_count, firef_tangent_corners, &job);
+        status = firef_split_vertices(scratch, obj, 3, indices, tangents, corner_total, vertex_total);
+    }
+
+    firef_free(scratch, indices);
+    firef_free(scratch, weld);
+    firef_free(scratch, corners);
+    firef_free(scratch, projected);
+    firef_free(scratch, weights);
+    firef_free(scratch, preserving);
+    firef_free(scratch, tangents);
+    firef_free(scratch, offsets);
+    return status;
+}
+
+int obj_generate_tangents(Obj *obj, int threads) {
+    return firef_generate_tangents(NULL, obj, threads);
+}
+
+
+#define FIREF_SIMPLIFY_EDGE_WEIGHT 10.0f
+
+// Symmetric 4x4 error quadric in the normalized space, with the total
+// weight of its planes.
+typedef struct {
+    float a00, a11, a22, a10, a20, a21;
+    float b0, b1, b2, c, w;
+} FirefQuadric;
+
+enum {
+    FIREF_VERTEX_MANIFOLD,
+    FIREF_VERTEX_BORDER,   // on an open edge loop
+    FIREF_VERTEX_SEAM,     // two vertices on a closed surface, split by uv or normal
+    FIREF_VERTEX_LOCKED
+};
+
+typedef struct {
+    unsigned int u, v; // vertex u collapses onto vertex v
+    float error;
+} FirefCollapse;
+
+typedef struct {
+    unsigned int *indices;      // current triangles over welded vertices
+    size_t index_count;
+    unsigned int *position;     // vertex -> welded position
+    unsigned int *wedge;        // vertex -> next vertex on the same position
+    float *points;              // per position, normalized
+    FirefQuadric *quadrics;     // per position
+    unsigned char *kind;        // per position
+    unsigned char *locked;      // per position, this pass
+    size_t *offsets;            // position -> range of adjacent
+    unsigned int *adjacent;     // triangles by position
+    unsigned int *loop;         // vertex -> end of its open edge, or UINT_MAX
+    unsigned int *loopback;     // vertex -> start of its open edge, or UINT_MAX
+    unsigned int *remap;        // vertex -> vertex, this pass
+    FirefCollapse *collapses;   // candidates, then as many for sorting
+    size_t vertex_total;
+    size_t position_total;
+    float error;                // largest accepted collapse error
+} FirefSimplifier;
+
+static void firef_quadric_add_plane(FirefQuadric *q, const float n[3], float d, float w) {
+    q->a00 += w * n[0] * n[0];
+    q->a11 += w * n[1] * n[1];
+    q->a22 += w * n[2] * n[2];
+    q->a10 += w * n[1] * n[0];
+    q->a20 += w * n[2] * n[0];
+    q->a21 += w * n[2] * n[1];
+    q->b0 += w * n[0] * d;
+    q->b1 += w * n[1] * d;
+    q->b2 += w * n[2] * d;
+    q->c += w * d * d;
+    q->w += w;
+}
+
+static void firef_quadric_merge(FirefQuadric *q, const FirefQuadric *other) {
+    q->a00 += other->a00;
+    q->a11 += other->a11;
+    q->a22 += other->a22;
+    q->a10 += other->a10;
+    q->a20 += other->a20;
+    q->a21 += other->a21;
+    q->b0 += other->b0;
+    q->b1 += other->b1;
+    q->b2 += other->b2;
+    q->c += other->c;
+    q->w += other->w;
+}
+
+// Weighted mean squared distance of p from the planes of q.
+static inline float firef_quadric_error(const FirefQuadric *q, const float p[3]) {
+    float rx = q->a00 * p[0] + q->a10 * p[1] + q->a20 * p[2] + q->b0 * 2.0f;
+    float ry = q->a10 * p[0] + q->a11 * p[1] + q->a21 * p[2] + q->b1 * 2.0f;
+    float rz = q->a20 * p[0] + q->a21 * p[1] + q->a22 * p[2] + q->b2 * 2.0f;
+    float r = rx * p[0] + ry * p[1] + rz * p[2] + q->c;
+    return q->w > 0.0f ? fabsf(r) / q->w : 0.0f;
+}
+
+// Plane through the edge a-b, perpendicular to the triangle with third
+// corner c, so that sliding off an open edge or seam costs error.
+static void firef_quadric_add_edge(FirefQuadric *q, const float *a, const float *b, const float *c, float weight) {
+    float e[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+    float f[3] = { c[0] - a[0], c[1] - a[1], c[2] - a[2] };
+    float length_sq = e[0] * e[0] + e[1] * e[1] + e[2] * e[2];
+    float along = e[0] * f[0] + e[1] * f[1] + e[2] * f[2];
+    float n[3] = { f[0] * length_sq - e[0] * along, f[1] * length_sq - e[1] * along, f[2] * length_sq - e[2] * along };
+    firef_normalize(n);
+    float d = -(n[0] * a[0] + n[1] * a[1] + n[2] * a[2]);
+    firef_quadric_add_plane(q, n, d, sqrtf(length_sq) * weight);
+}
+
+static void firef_simplify_adjacency(FirefSimplifier *s) {
+    firef_build_vertex_triangles(s->indices, s->index_count, s->position, s->position_total, 0, s->offsets, s->adjacent);
+}
+
+// Whether some triangle has the directed edge a -> b, comparing vertices
+// or only their positions.
+static int firef_simplify_has_edge(const FirefSimplifier *s, unsigned int a, unsigned int b, int by_position) {
+    unsigned int pa = s->position[a], pb = s->position[b];
+    for (size_t k = s->offsets[pa]; k < s->offsets[pa + 1]; k++) {
+        const unsigned int *tri = s->indices + (size_t)s->adjacent[k] * 3;
+        for (int c = 0; c < 3; c++) {
+            unsigned int from = tri[c], to = tri[(c + 1) % 3];
+            if (by_position ? s->position[from] == pa && s->position[to] == pb : from == a && to == b) return 1;
+        }
+    }
+    return 0;
+}
+
+// Sorts positions into the kinds above from the open edges around them,
+// and adds edge planes along borders and seams to the quadrics.
+static int firef_simplify_classify(FirefSimplifier *s) {
+    unsigned int *counts = (unsigned int*)firef_calloc(s->position_total * 3 + s->vertex_total * 2 + 1, sizeof(unsigned int));
+    if (!counts) return -1;
+    unsigned int *wedge_size = counts;
+    unsigned int *open_out = wedge_size + s->position_total;
+    unsigned int *open_in = open_out + s->position_total;
+    unsigned int *seam_out = open_in + s->position_total;
+    unsigned int *seam_in = seam_out + s->vertex_total;
+
+    for (size_t v = 0; v < s->vertex_total; v++) {
+        if (s->remap[v]) wedge_size[s->position[v]]++;
+    }
+    for (size_t i = 0; i < s->index_count; i++) {
+        const unsigned int *tri = s->indices + i / 3 * 3;
+        unsigned int a = s->indices[i], b = tri[(i + 1) % 3], c = tri[(i + 2) % 3];
+        unsigned int pa = s->position[a], pb = s->position[b];
+        const float *pc = s->points + (size_t)s->position[c] * 3;
+        int open = !firef_simplify_has_edge(s, b, a, 1);
+        if (!open && firef_simplify_has_edge(s, b, a, 0)) continue;
+        if (open) {
+            open_out[pa]++;
+            open_in[pb]++;
+        } else {
+            seam_out[a]++;
+            seam_in[b]++;
+        }
+        FirefQuadric edge;
+        memset(&edge, 0, sizeof(edge));
+        firef_quadric_add_edge(&edge, s->points + (size_t)pa * 3, s->points + (size_t)pb * 3, pc, FIREF_SIMPLIFY_EDGE_WEIGHT);
+        firef_quadric_merge(&s->quadrics[pa], &edge);
+        firef_quadric_merge(&s->quadrics[pb], &edge);
+    }
+
+    for (size_t p = 0; p < s->position_total; p++) {
+        unsigned char kind = FIREF_VERTEX_LOCKED;
+        if (wedge_size[p] == 1 && open_out[p] == 0 && open_in[p] == 0) kind = FIREF_VERTEX_MANIFOLD;
+        if (wedge_size[p] == 1 && open_out[p] == 1 && open_in[p] == 1) kind = FIREF_VERTEX_BORDER;
+        if (wedge_size[p] == 2 && open_out[p] == 0 && open_in[p] == 0) kind = FIREF_VERTEX_SEAM;
+        s->kind[p] = kind;
+    }
+    // A seam needs exactly one seam edge in and out on each side; a single
+    // vertex where a seam ends stays put.
+    for (size_t v = 0; v < s->vertex_total; v++) {
+        if (!s->remap[v]) continue;
+        unsigned int p = s->position[v];
+        int seam = seam_out[v] == 1 && seam_in[v] == 1;
+        if (s->kind[p] == FIREF_VERTEX_SEAM ? !seam : seam_out[v] || seam_in[v]) s->kind[p] = FIREF_VERTEX_LOCKED;
+    }
+    FIREF_FREE(counts);
+    return 0;
+}
+
+// Finds the open edge in and out of every border and seam vertex: along
+// positions for borders, along vertices for seams.
+static void firef_simplify_loops(FirefSimplifier *s) {
+    memset(s->loop, 0xFF, s->vertex_total * sizeof(unsigned int));
+    memset(s->loopback, 0xFF, s->vertex_total * sizeof(unsigned int));
+    for (size_t i = 0; i < s->index_count; i++) {
+        const unsigned int *tri = s->indices + i / 3 * 3;
+        unsigned int a = s->indices[i], b = tri[(i + 1) % 3];
+        unsigned char ka = s->kind[s->position[a]], kb = s->kind[s->position[b]];
+        if (ka != FIREF_VERTEX_BORDER && ka != FIREF_VERTEX_SEAM && kb != FIREF_VERTEX_BORDER && kb != FIREF_VERTEX_SEAM) continue;
+        int open = !firef_simplify_has_edge(s, b, a, 1);
+        int seam = !open && !firef_simplify_has_edge(s, b, a, 0);
+        if ((ka == FIREF_VERTEX_BORDER && open) || (ka == FIREF_VERTEX_SEAM && seam)) s->loop[a] = b;
+        if ((kb == FIREF_VERTEX_BORDER && open) || (kb == FIREF_VERTEX_SEAM && seam)) s->loopback[b] = a;
+    }
+}
+
+static int firef_simplify_allowed(const FirefSimplifier *s, unsigned int u, unsigned int v) {
+    unsigned char ku = s->kind[s->position[u]], kv = s->kind[s->position[v]];
+    if (ku == FIREF_VERTEX_MANIFOLD) return 1;
+    if (ku == FIREF_VERTEX_LOCKED || kv != ku || (s->loop[u] != v && s->loopback[u] != v)) return 0;
+    if (ku == FIREF_VERTEX_BORDER) return 1;
+    // The other side of the seam has to run along the same edge.
+    unsigned int u1 = s->wedge[u], v1 = s->wedge[v];
+    return s->loop[u1] == v1 || s->loopback[u1] == v1;
+}
+
+// Whether moving position pu onto pv turns over a triangle that survives.
+static int firef_simplify_flips(const FirefSimplifier *s, unsigned int pu, unsigned int pv) {
+    const float *target = s->points + (size_t)pv * 3;
+    for (size_t k = s->offsets[pu]; k < s->offsets[pu + 1]; k++) {
+        const unsigned int *tri = s->indices + (size_t)s->adjacent[k] * 3;
+        unsigned int q[3] = { s->position[tri[0]], s->position[tri[1]], s->position[tri[2]] };
+        if (q[0] == pv || q[1] == pv || q[2] == pv) continue;
+        const float *p[3], *r[3];
+        for (int c = 0; c < 3; c++) {
+            p[c] = s->points + (size_t)q[c] * 3;
+            r[c] = q[c] == pu ? target : p[c];
+        }
+        float e1[3] = { p[1][0] - p[0][0], p[1][1] - p[0][1], p[1][2] - p[0][2] };
+        float e2[3] = { p[2][0] - p[0][0], p[2][1] - p[0][1], p[2][2] - p[0][2] };
+        float f1[3] = { r[1][0] - r[0][0], r[1][1] - r[0][1], r[1][2] - r[0][2] };
+        float f2[3] = { r[2][0] - r[0][0], r[2][1] - r[0][1], r[2][2] - r[0][2] };
+        float n0[3] = { e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0] };
+        float n1[3] = { f1[1] * f2[2] - f1[2] * f2[1], f1[2] * f2[0] - f1[0] * f2[2], f1[0] * f2[1] - f1[1] * f2[0] };
+        float before = n0[0] * n0[0] + n0[1] * n0[1] + n0[2] * n0[2];
+        if (before > 0.0f && n0[0] * n1[0] + n0[1] * n1[1] + n0[2] * n1[2] <= 0.0f) return 1;
+    }
+    return 0;
+}
+
+// Sorts collapses by error with three 11-bit radix passes over the bits
+// of the (non-negative) float; the result ends up in collapses.
+static void firef_sort_collapses(FirefCollapse *collapses, FirefCollapse *scratch, size_t count) {
+    FirefCollapse *from = collapses, *to = scratch;
+    for (int shift = 0; shift < 33; shift += 11) {
+        size_t histogram[2048];
+        memset(histogram, 0, sizeof(histogram));
+        for (size_t i = 0; i < count; i++) {
+            uint32_t key;
+            memcpy(&key, &from[i].error, sizeof(key));
+            histogram[(key >> shift) & 2047]++;
+        }
+        size_t sum = 0;
+        for (int b = 0; b < 2048; b++) {
+            size_t n = histogram[b];
+            histogram[b] = sum;
+            sum += n;
+        }
+        for (size_t i = 0; i < count; i++) {
+            uint32_t key;
+            memcpy(&key, &from[i].error, sizeof(key));
+            to[histogram[(key >> shift) & 2047]++] = from[i];
+        }
+        FirefCollapse *swap = from;
+        from = to;
+        to = swap;
+    }
+    if (from != collapses) memcpy(collapses, from, count * sizeof(FirefCollapse));
+}
+
+// One round of independent collapses, cheapest first, none of which
+// touch the neighborhood of another. Returns the number applied.
+static size_t firef_simplify_pass(FirefSimplifier *s, size_t target_index_count, float limit) {
+    firef_simplify_adjacency(s);
+    firef_simplify_loops(s);
+
+    size_t count = 0;
+    for (size_t i = 0; i < s->index_count; i++) {
+        const unsigned int *tri = s->indices + i / 3 * 3;
+        unsigned int a = s->indices[i], b = tri[(i + 1) % 3];
+        unsigned int pa = s->position[a], pb = s->position[b];
+        // Edges between two manifold vertices show up in both directions.
+        if (pa > pb && s->kind[pa] == FIREF_VERTEX_MANIFOLD && s->kind[pb] == FIREF_VERTEX_MANIFOLD) continue;
+        int ab = firef_simplify_allowed(s, a, b), ba = firef_simplify_allowed(s, b, a);
+        if (!ab && !ba) continue;
+        FirefQuadric q = s->quadrics[pa];
+        firef_quadric_merge(&q, &s->quadrics[pb]);
+        float eab = ab ? firef_quadric_error(&q, s->points + (size_t)pb * 3) : FLT_MAX;
+        float eba = ba ? firef_quadric_error(&q, s->points + (size_t)pa * 3) : FLT_MAX;
+        FirefCollapse *c = &s->collapses[count++];
+        c->u = eab <= eba ? a : b;
+        c->v = eab <= eba ? b : a;
+        c->error = eab <= eba ? eab : eba;
+    }
+    if (count == 0) return 0;
+    firef_sort_collapses(s->collapses, s->collapses + s->index_count, count);
+
+    // Every collapse removes about two triangles; do not run far past the
+    // cheapest half of what is needed in one round.
+    size_t triangle_goal = (s->index_count - target_index_count) / 3;
+    size_t edge_goal = triangle_goal / 2 ? triangle_goal / 2 : 1;
+    float error_goal = edge_goal < count ? s->collapses[edge_goal].error * 1.5f : FLT_MAX;
+
+    for (size_t v = 0; v < s->vertex_total; v++) s->remap[v] = (unsigned int)v;
+    memset(s->locked, 0, s->position_total);
+    size_t applied = 0, removed = 0;
+    for (size_t k = 0; k < count && removed < triangle_goal; k++) {
+        const FirefCollapse *c = &s->collapses[k];
+        if (c->error > limit || c->error > error_goal) break;
+        unsigned int pu = s->position[c->u], pv = s->position[c->v];
+        if (s->locked[pu] || s->locked[pv] || firef_simplify_flips(s, pu, pv)) continue;
+
+        s->remap[c->u] = c->v;
+        if (s->kind[pu] == FIREF_VERTEX_SEAM) s->remap[s->wedge[c->u]] = s->wedge[c->v];
+        firef_quadric_merge(&s->quadrics[pv], &s->quadrics[pu]);
+        for (size_t j = s->offsets[pu]; j < s->offsets[pu + 1]; j++) {
+            const unsigned int *tri = s->indices + (size_t)s->adjacent[j] * 3;
+            for (int n = 0; n < 3; n++) s->locked[s->position[tri[n]]] = 1;
+        }
+        removed += s->kind[pu] == FIREF_VERTEX_BORDER ? 1 : 2;
+        if (c->error > s->error) s->error = c->error;
+        applied++;
+    }
+
+    size_t write = 0;
+    for (size_t i = 0; i < s->index_count; i += 3) {
+        unsigned int a = s->remap[s->indices[i]], b = s->remap[s->indices[i + 1]], c = s->remap[s->indices[i + 2]];
+        unsigned int pa = s->position[a], pb = s->position[b], pc = s->position[c];
+        if (pa == pb || pa == pc || pb == pc) continue;
+        s->indices[write++] = a;
+        s->indices[write++] = b;
+        s->indices[write++] = c;
+    }
+    s->index_count = write;
+    return applied;
+}
+
+static void firef_free_simplifier(FirefSimplifier *s) {
+    FIREF_FREE(s->indices);
+    FIREF_FREE(s->position);
+    FIREF_FREE(s->wedge);
+    FIREF_FREE(s->points);
+    FIREF_FREE(s->quadrics);
+    FIREF_FREE(s->kind);
+    FIREF_FREE(s->locked);
+    FIREF_FREE(s->offsets);
+    FIREF_FREE(s->adjacent);
+    FIREF_FREE(s->loop);
+    FIREF_FREE(s->loopback);
+    FIREF_FREE(s->remap);
+    FIREF_FREE(s->collapses);
+}
+
+// Welds obj by positions and the seams attributes and computes the
+// quadrics and vertex kinds. Returns 0, or -1 when out of memory.
+static int firef_init_simplifier(FirefSimplifier *s, const Obj *obj, size_t vertex_total, unsigned int seams, float *scale) {
+    size_t index_total = obj->index_count / 3 * 3;
+    s->vertex_total = vertex_total;
+    s->indices = (unsigned int*)FIREF_MALLOC((index_total ? index_total : 1) * sizeof(unsigned int));
+    s->position = (unsigned int*)FIREF_MALLOC(vertex_total * sizeof(unsigned int));
+    s->wedge = (unsigned int*)FIREF_MALLOC(vertex_total * sizeof(unsigned int));
+    s->loop = (unsigned int*)FIREF_MALLOC(vertex_total * sizeof(unsigned int));
+    s->loopback = (unsigned int*)FIREF_MALLOC(vertex_total * sizeof(unsigned int));
+    s->remap = (unsigned int*)FIREF_MALLOC(vertex_total * sizeof(unsigned int));
+    s->adjacent = (unsigned int*)FIREF_MALLOC((index_total ? index_total : 1) * sizeof(unsigned int));
+    s->collapses = (FirefCollapse*)FIREF_MALLOC((index_total ? index_total : 1) * 2 * sizeof(FirefCollapse));
+    if (!s->indices || !s->position || !s->wedge || !s->loop || !s->loopback || !s->remap || !s->adjacent || !s->collapses) return -1;
+
+    // Corners that only differ outside seams become one vertex: the first.
+    unsigned int mask = FIREF_LOAD_POSITIONS | (obj->attributes & seams);
+    size_t group_total = firef_weld_vertices(NULL, obj, vertex_total, mask, s->wedge);
+    if (group_total == (size_t)-1) return -1;
+    memset(s->loop, 0xFF, vertex_total * sizeof(unsigned int));
+    for (size_t v = 0; v < vertex_total; v++) {
+        if (s->loop[s->wedge[v]] == UINT_MAX) s->loop[s->wedge[v]] = (unsigned int)v;
+    }
+    for (size_t i = 0; i < index_total; i++) s->indices[i] = s->loop[s->wedge[firef_index_at(obj, i)]];
+
+    s->position_total = firef_weld_vertices(NULL, obj, vertex_total, FIREF_LOAD_POSITIONS, s->position);
+    if (s->position_total == (size_t)-1) return -1;
+    s->points = (float*)FIREF_MALLOC(s->position_total * 3 * sizeof(float) + 1);
+    s->quadrics = (FirefQuadric*)firef_calloc(s->position_total + 1, sizeof(FirefQuadric));
+    s->kind = (unsigned char*)FIREF_MALLOC(s->position_total + 1);
+    s->locked = (unsigned char*)FIREF_MALLOC(s->position_total + 1);
+    s->offsets = (size_t*)FIREF_MALLOC((s->position_total + 1) * sizeof(size_t));
+    if (!s->points || !s->quadrics || !s->kind || !s->locked || !s->offsets) return -1;
+
+    // Work in a unit box so that errors compare across meshes.
+    float lo[3] = { FLT_MAX, FLT_MAX, FLT_MAX }, hi[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+    for (size_t v = 0; v < vertex_total; v++) {
+        const float *p = firef_vertex_attribute(obj, v, 0);
+        for (int k = 0; k < 3; k++) {
+            lo[k] = p[k] < lo[k] ? p[k] : lo[k];
+            hi[k] = p[k] > hi[k] ? p[k] : hi[k];
+        }
+    }
+    float extent = 0.0f;
+    for (int k = 0; k < 3; k++) extent = hi[k] - lo[k] > extent ? hi[k] - lo[k] : extent;
+    *scale = extent > 0.0f ? extent : 1.0f;
+    for (size_t v = 0; v < vertex_total; v++) {
+        const float *p = firef_vertex_attribute(obj, v, 0);
+        for (int k = 0; k < 3; k++) s->points[(size_t)s->position[v] * 3 + k] = (p[k] - lo[k]) / *scale;
+    }
+
+    // Drop triangles that are already degenerate, then plane quadrics
+    // weighted by the square root of the area.
+    size_t write = 0;
+    for (size_t i = 0; i < index_total; i += 3) {
+        unsigned int a = s->indices[i], b = s->indices[i + 1], c = s->indices[i + 2];
+        unsigned int pa = s->position[a], pb = s->position[b], pc = s->position[c];
+        if (pa == pb || pa == pc || pb == pc) continue;
+        s->indices[write++] = a;
+        s->indices[write++] = b;
+        s->indices[write++] = c;
+
+        const float *p0 = s->points + (size_t)pa * 3, *p1 = s->points + (size_t)pb * 3, *p2 = s->points + (size_t)pc * 3;
+        float e1[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+        float e2[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+        float n[3] = { e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0] };
+        float area = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+        firef_normalize(n);
+        float d = -(n[0] * p0[0] + n[1] * p0[1] + n[2] * p0[2]);
+        FirefQuadric plane;
+        memset(&plane, 0, sizeof(plane));
+        firef_quadric_add_plane(&plane, n, d, sqrtf(area));
+        firef_quadric_merge(&s->quadrics[pa], &plane);
+        firef_quadric_merge(&s->quadrics[pb], &plane);
+        firef_quadric_merge(&s->quadrics[pc], &plane);
+    }
+    s->index_count = write;
+
+    // Ring of the used vertices on each position (remap marks use here).
+    memset(s->remap, 0, vertex_total * sizeof(unsigned int));
+    for (size_t i = 0; i < s->index_count; i++) s->remap[s->indices[i]] = 1;
+    memset(s->loop, 0xFF, s->position_total * sizeof(unsigned int));
+    for (size_t v = 0; v < vertex_total; v++) {
+        s->wedge[v] = (unsigned int)v;
+        if (!s->remap[v]) continue;
+        unsigned int *first = &s->loop[s->position[v]];
+        if (*first == UINT_MAX) {
+            *first = (unsigned int)v;
+        } else {
+            s->wedge[v] = s->wedge[*first];
+            s->wedge[*first] = (unsigned int)v;
+        }
+    }
+
+    firef_simplify_adjacency(s);
+    return firef_simplify_classify(s);
+}
+
+int obj_build_lods(const Obj *obj, const float *ratios, size_t ratio_count, float max_error, unsigned int seams, ObjLodChain *out) {
+    memset(out, 0, sizeof(*out));
+    if (!(obj->attributes & FIREF_LOAD_POSITIONS)) return -1;
+    size_t vertex_total = firef_obj_vertex_total(obj);
+    size_t tri_count = obj->index_count / 3;
+    for (size_t i = 0; i < tri_count * 3; i++) {
+        if (firef_index_at(obj, i) >= vertex_total) return -1;
+    }
+    if (ratio_count == 0) return 0;
+    out->levels = (ObjLod*)firef_calloc(ratio_count, sizeof(ObjLod));
+    if (!out->levels) return -1;
+    out->level_count = ratio_count;
+    if (vertex_total == 0) return 0;
+
+    FirefSimplifier s;
+    memset(&s, 0, sizeof(s));
+    float scale = 1.0f;
+    int status = firef_init_simplifier(&s, obj, vertex_total, seams, &scale);
+    float limit = max_error >= 1.0f ? FLT_MAX : max_error * max_error;
+
+    for (size_t l = 0; l < ratio_count && status == 0; l++) {
+        float ratio = ratios[l] < 0.0f ? 0.0f : ratios[l] > 1.0f ? 1.0f : ratios[l];
+        size_t target = (size_t)((double)tri_count * ratio) * 3;
+        while (s.index_count > target) {
+            if (firef_simplify_pass(&s, target, limit) == 0) break;
+        }
+        ObjLod *lod = &out->levels[l];
+        lod->indices = (unsigned int*)FIREF_MALLOC((s.index_count ? s.index_count : 1) * sizeof(unsigned int));
+        if (!lod->indices) {
+            status = -1;
+            break;
+        }
+        memcpy(lod->indices, s.indices, s.index_count * sizeof(unsigned int));
+        lod->index_count = s.index_count;
+        lod->error = sqrtf(s.error) * scale;
+    }
+
+    firef_free_simplifier(&s);
+    if (status != 0) free_lod_chain(out);
+    return status;
+}
+
+int obj_simplify(const Obj *obj, float ratio, float max_error, unsigned int seams, ObjLod *out) {
+    ObjLodChain chain;
+    memset(out, 0, sizeof(*out));
+    if (obj_build_lods(obj, &ratio, 1, max_error, seams, &chain) != 0) return -1;
+    if (chain.level_count) *out = chain.levels[0];
+    FIREF_FREE(chain.levels);
+    return 0;
+}
+
+void free_lod(ObjLod *lod) {
+    FIREF_FREE(lod->indices);
+    memset(lod, 0, sizeof(*lod));
+}
+
+void free_lod_chain(ObjLodChain *chain) {
+    for (size_t l = 0; l < chain->level_count; l++) free_lod(&chain->levels[l]);
+    FIREF_FREE(chain->levels);
+    memset(chain, 0, sizeof(*chain));
 }
 
 #endif